@@ -15,10 +15,21 @@
  * http://www.perlfoundation.org/artistic_license_2_0.
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <monobus.h>
 
 #define FRAMING 0x7e
 #define ESCAPE 0x7d
+#define JAN_1970 2208988800LL // Unix epoch in seconds since NTP epoch
+#define NSECS 1000000000LL
 
 uint8_t
 monobus_crc8(uint8_t seed, const uint8_t *data, size_t len)
@@ -97,6 +108,116 @@ monobus_message(uint8_t *dst, size_t dst_len, uint8_t command, uint8_t id,
 	return len;
 }
 
+speed_t
+monobus_termios_speed(uint32_t baud)
+{
+	switch(baud)
+	{
+		case 9600:
+			return B9600;
+		case 19200:
+			return B19200;
+		case 38400:
+			return B38400;
+		case 57600:
+			return B57600;
+		case 115200:
+			return B115200;
+		case 230400:
+			return B230400;
+		case 460800:
+			return B460800;
+		case 921600:
+			return B921600;
+	}
+
+	return B0; // unsupported
+}
+
+int64_t
+monobus_timetag_ns(uint64_t timetag)
+{
+	const int64_t sec = (int64_t)(timetag >> 32) - JAN_1970;
+	const uint64_t frac = timetag & 0xffffffff;
+
+	// 32.32 fixed point fraction rounded to nearest nanosecond
+	return sec * NSECS + (int64_t)((frac * NSECS + 0x80000000) >> 32);
+}
+
+void
+monobus_unframer_reset(unframer_t *unframer)
+{
+	unframer->framed = false;
+	unframer->escaped = false;
+	unframer->sum = 0xff;
+	unframer->mark = 0xff;
+	unframer->len = 0;
+}
+
+int
+monobus_unframer_feed(unframer_t *unframer, uint8_t byt, const uint8_t **frame,
+	size_t *len)
+{
+	if(byt == FRAMING)
+	{
+		const bool framed = unframer->framed;
+		const size_t n = unframer->len;
+		const uint8_t crc = n ? unframer->buf[n - 1] : 0x0;
+		const bool valid = !unframer->escaped && (crc == unframer->mark);
+
+		// framing byte both ends current and starts next message
+		monobus_unframer_reset(unframer);
+		unframer->framed = true;
+
+		if(!framed || (n < 2) )
+		{
+			return 0; // nothing in between
+		}
+
+		if(!valid)
+		{
+			return -1;
+		}
+
+		*frame = unframer->buf;
+		*len = n - 1; // without checksum
+
+		return 1;
+	}
+
+	if(!unframer->framed)
+	{
+		return 0; // wait for start of message
+	}
+
+	if(!unframer->escaped)
+	{
+		// checksum covers escaped bytes on the wire
+		unframer->mark = unframer->sum;
+	}
+
+	unframer->sum = monobus_crc8(unframer->sum, &byt, 1);
+
+	if(byt == ESCAPE)
+	{
+		unframer->escaped = true;
+		return 0;
+	}
+
+	if(unframer->len == MONOBUS_FRAME_MAX)
+	{
+		unframer->framed = false; // resync with next framing byte
+		return -1;
+	}
+
+	unframer->buf[unframer->len++] = unframer->escaped
+		? byt ^ 0x20
+		: byt;
+	unframer->escaped = false;
+
+	return 0;
+}
+
 unsigned
 monobus_stride_for_width(unsigned width)
 {
@@ -106,12 +227,12 @@ monobus_stride_for_width(unsigned width)
 static bool
 _get_bit(const uint8_t *blob, unsigned y, unsigned x, unsigned width)
 {
-	x = width - x - 1;
+	// rows are padded to full bytes, most significant bit first like in PBM
 	const unsigned stride = monobus_stride_for_width(width);
 	const unsigned row_offset = y * stride;
-	const unsigned col_offset = stride - (x / 8) - 1;
+	const unsigned col_offset = x / 8;
 	const uint8_t byte = blob[row_offset + col_offset];
-	const uint8_t mask = 1 << (x % 8);
+	const uint8_t mask = 0x80 >> (x % 8);
 
 	return (byte & mask);
 }
@@ -175,6 +296,1499 @@ _clr_pixels(state_t *state, uint8_t prio, int32_t offx, int32_t offy,
 	}
 }
 
+static void
+_put_le(uint8_t *dst, uint64_t val, unsigned len)
+{
+	for(unsigned i = 0; i < len; i++, val >>= 8)
+	{
+		dst[i] = val & 0xff;
+	}
+}
+
+static uint64_t
+_get_le(const uint8_t *src, unsigned len)
+{
+	uint64_t val = 0;
+
+	for(unsigned i = len; i > 0; i--)
+	{
+		val = (val << 8) | src[i - 1];
+	}
+
+	return val;
+}
+
+ssize_t
+monobus_bin_encode(uint8_t *dst, size_t dst_len, const bin_update_t *update)
+{
+	const bool stamp = update->flags & BIN_FLAG_TIMETAG;
+	const size_t len = (update->flags & BIN_FLAG_CLEAR) ? 0 : update->len;
+	const size_t tot_len = MONOBUS_BIN_HEADER
+		+ (stamp ? MONOBUS_BIN_STAMP : 0) + len;
+
+	if(tot_len > dst_len)
+	{
+		return -1;
+	}
+
+	_put_le(&dst[0], MONOBUS_BIN_MAGIC, 4);
+	dst[4] = update->layer;
+	dst[5] = update->flags;
+	_put_le(&dst[6], (uint16_t)update->x, 2);
+	_put_le(&dst[8], (uint16_t)update->y, 2);
+	_put_le(&dst[10], update->width, 2);
+	_put_le(&dst[12], update->height, 2);
+	_put_le(&dst[14], 0x0, 2);
+
+	uint8_t *ptr = &dst[MONOBUS_BIN_HEADER];
+
+	if(stamp)
+	{
+		_put_le(ptr, update->timetag, MONOBUS_BIN_STAMP);
+		ptr += MONOBUS_BIN_STAMP;
+	}
+
+	if(len && update->bitmap) // otherwise left for caller to fill in
+	{
+		memcpy(ptr, update->bitmap, len);
+	}
+
+	return tot_len;
+}
+
+int
+monobus_bin_decode(bin_update_t *update, const uint8_t *src, size_t src_len)
+{
+	if( (src_len < MONOBUS_BIN_HEADER)
+		|| (_get_le(&src[0], 4) != MONOBUS_BIN_MAGIC) )
+	{
+		return -1;
+	}
+
+	update->layer = src[4];
+	update->flags = src[5];
+	update->x = (int16_t)_get_le(&src[6], 2);
+	update->y = (int16_t)_get_le(&src[8], 2);
+	update->width = _get_le(&src[10], 2);
+	update->height = _get_le(&src[12], 2);
+	update->timetag = 0;
+	update->bitmap = NULL;
+	update->len = 0;
+
+	if(update->layer >= 32)
+	{
+		return -1;
+	}
+
+	const uint8_t *ptr = &src[MONOBUS_BIN_HEADER];
+	const uint8_t *end = src + src_len;
+
+	if(update->flags & BIN_FLAG_TIMETAG)
+	{
+		if(MONOBUS_BIN_STAMP > (size_t)(end - ptr) )
+		{
+			return -1;
+		}
+
+		update->timetag = _get_le(ptr, MONOBUS_BIN_STAMP);
+		ptr += MONOBUS_BIN_STAMP;
+	}
+
+	if( !(update->flags & BIN_FLAG_CLEAR) )
+	{
+		const size_t tot_len = (size_t)monobus_stride_for_width(update->width)
+			* update->height;
+
+		// compare lengths, as pointer past buffer may wrap on 32-bit targets
+		if(tot_len > (size_t)(end - ptr) )
+		{
+			return -1;
+		}
+
+		update->bitmap = ptr;
+		update->len = tot_len;
+	}
+
+	return 0;
+}
+
+void
+monobus_bin_apply(state_t *state, const bin_update_t *update)
+{
+	if(update->flags & BIN_FLAG_CLEAR)
+	{
+		_clr_pixels(state, update->layer, update->x, update->y,
+			update->width, update->height);
+	}
+	else
+	{
+		_set_pixels(state, update->layer, update->x, update->y,
+			update->width, update->height, update->bitmap);
+	}
+}
+
+int
+monobus_pbm_init(pbm_reader_t *reader, int fd)
+{
+	struct stat st;
+
+	memset(reader, 0x0, sizeof(pbm_reader_t));
+	reader->fd = fd;
+	reader->ptr = reader->buf;
+	reader->end = reader->buf;
+
+	if(fstat(fd, &st) == -1)
+	{
+		return -1;
+	}
+
+	// map whole regular files, read everything else chunk-wise
+	if(S_ISREG(st.st_mode) && (st.st_size > 0) )
+	{
+		reader->map_len = st.st_size;
+		reader->map = mmap(NULL, reader->map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if(reader->map == MAP_FAILED)
+		{
+			reader->map = NULL;
+			reader->map_len = 0;
+			return 0;
+		}
+
+		madvise(reader->map, reader->map_len, MADV_SEQUENTIAL);
+
+		reader->ptr = reader->map;
+		reader->end = reader->map + reader->map_len;
+	}
+
+	return 0;
+}
+
+void
+monobus_pbm_deinit(pbm_reader_t *reader)
+{
+	if(reader->map)
+	{
+		munmap(reader->map, reader->map_len);
+		reader->map = NULL;
+	}
+}
+
+static bool
+_pbm_fill(pbm_reader_t *reader)
+{
+	if(reader->ptr < reader->end)
+	{
+		return true;
+	}
+
+	if(reader->map) // end of mapping
+	{
+		return false;
+	}
+
+	ssize_t len;
+	while( ((len = read(reader->fd, reader->buf, sizeof(reader->buf))) == -1)
+		&& (errno == EINTR) )
+	{
+		// retry
+	}
+
+	if(len <= 0)
+	{
+		return false;
+	}
+
+	reader->ptr = reader->buf;
+	reader->end = reader->buf + len;
+
+	return true;
+}
+
+static int
+_pbm_getc(pbm_reader_t *reader)
+{
+	return _pbm_fill(reader) ? *reader->ptr++ : -1;
+}
+
+static int
+_pbm_skip(pbm_reader_t *reader)
+{
+	// skip whitespace and comments
+	while(_pbm_fill(reader))
+	{
+		const int c = *reader->ptr;
+
+		if(c == '#')
+		{
+			int d;
+			while( ((d = _pbm_getc(reader)) != -1) && (d != '\n') && (d != '\r') )
+			{
+				// skip comment
+			}
+		}
+		else if( (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r')
+			|| (c == '\v') || (c == '\f') )
+		{
+			reader->ptr++;
+		}
+		else
+		{
+			return c;
+		}
+	}
+
+	return -1;
+}
+
+static int
+_pbm_uint(pbm_reader_t *reader, unsigned *val)
+{
+	int c = _pbm_skip(reader);
+
+	if( (c < '0') || (c > '9') )
+	{
+		return -1;
+	}
+
+	*val = 0;
+	while(_pbm_fill(reader) && ( (c = *reader->ptr) >= '0') && (c <= '9') )
+	{
+		if(*val > (UINT_MAX - (c - '0')) / 10)
+		{
+			return -1; // overflow
+		}
+
+		*val = *val * 10 + (c - '0');
+		reader->ptr++;
+	}
+
+	return 0;
+}
+
+int
+monobus_pbm_next(pbm_reader_t *reader, pbm_image_t *image)
+{
+	if(_pbm_skip(reader) == -1)
+	{
+		return 0; // end of file
+	}
+
+	if( (_pbm_getc(reader) != 'P') )
+	{
+		return -1;
+	}
+
+	const int magic = _pbm_getc(reader);
+
+	switch(magic)
+	{
+		case '1':
+		case '4':
+		{
+			image->channels = 0;
+		} break;
+		case '2':
+		case '5':
+		{
+			image->channels = 1;
+		} break;
+		case '3':
+		case '6':
+		{
+			image->channels = 3;
+		} break;
+		default:
+		{
+			return -1; // no PNM
+		}
+	}
+
+	image->raw = magic >= '4';
+
+	// header is untrusted, bound dimensions before sizing any buffer by them
+	if(  (_pbm_uint(reader, &image->width) != 0)
+		|| (_pbm_uint(reader, &image->height) != 0)
+		|| (image->width > MONOBUS_PNM_MAX) || (image->height > MONOBUS_PNM_MAX) )
+	{
+		return -1;
+	}
+
+	if(image->channels == 0)
+	{
+		image->maxval = 1;
+	}
+	else if( (_pbm_uint(reader, &image->maxval) != 0)
+		|| (image->maxval == 0) || (image->maxval > UINT16_MAX) )
+	{
+		return -1;
+	}
+
+	if(image->raw)
+	{
+		// exactly one whitespace separates header from raster
+		_pbm_getc(reader);
+	}
+
+	if(image->channels == 0)
+	{
+		image->stride = monobus_stride_for_width(image->width);
+	}
+	else
+	{
+		image->stride = image->width;
+	}
+
+	if( (image->height != 0) && ((size_t)image->stride > SIZE_MAX / image->height) )
+	{
+		return -1;
+	}
+
+	image->len = (size_t)image->stride * image->height;
+
+	return 1;
+}
+
+static int
+_pbm_copy(pbm_reader_t *reader, uint8_t *dst, size_t len)
+{
+	while(len > 0)
+	{
+		if(!_pbm_fill(reader))
+		{
+			return -1;
+		}
+
+		const size_t avail = reader->end - reader->ptr;
+		const size_t part = avail < len ? avail : len;
+
+		memcpy(dst, reader->ptr, part);
+		reader->ptr += part;
+		dst += part;
+		len -= part;
+	}
+
+	return 0;
+}
+
+int
+monobus_pbm_decode(pbm_reader_t *reader, const pbm_image_t *image,
+	uint8_t *dst)
+{
+	if(image->channels != 0)
+	{
+		return -1; // no bitmap
+	}
+
+	if(image->raw) // raster layout matches bitmap payload format
+	{
+		return _pbm_copy(reader, dst, image->len);
+	}
+
+	memset(dst, 0x0, image->len);
+
+	for(unsigned y = 0; y < image->height; y++)
+	{
+		uint8_t *row = &dst[y * image->stride];
+
+		for(unsigned x = 0; x < image->width; x++)
+		{
+			switch(_pbm_skip(reader))
+			{
+				case '1':
+				{
+					row[x / 8] |= 0x80 >> (x % 8);
+				} break;
+				case '0':
+				{
+					// pixel off
+				} break;
+				default:
+				{
+					return -1;
+				}
+			}
+
+			reader->ptr++;
+		}
+	}
+
+	return 0;
+}
+
+static int
+_pbm_sample(pbm_reader_t *reader, const pbm_image_t *image, unsigned *val)
+{
+	if(!image->raw)
+	{
+		if(_pbm_uint(reader, val) != 0)
+		{
+			return -1;
+		}
+	}
+	else if(image->maxval < 0x100)
+	{
+		const int lo = _pbm_getc(reader);
+
+		if(lo == -1)
+		{
+			return -1;
+		}
+
+		*val = lo;
+	}
+	else // 16-bit samples are big-endian
+	{
+		const int hi = _pbm_getc(reader);
+		const int lo = _pbm_getc(reader);
+
+		if( (hi == -1) || (lo == -1) )
+		{
+			return -1;
+		}
+
+		*val = (hi << 8) | lo;
+	}
+
+	if(*val > image->maxval)
+	{
+		*val = image->maxval;
+	}
+
+	return 0;
+}
+
+int
+monobus_pbm_decode_gray(pbm_reader_t *reader, const pbm_image_t *image,
+	uint8_t *dst)
+{
+	if(image->channels == 0)
+	{
+		return -1; // no graymap nor pixmap
+	}
+
+	if(image->raw && (image->channels == 1) && (image->maxval == 0xff) )
+	{
+		// raster layout matches 8-bit luminance
+		return _pbm_copy(reader, dst, image->len);
+	}
+
+	const uint32_t maxval = image->maxval;
+
+	for(size_t i = 0; i < image->len; i++)
+	{
+		uint32_t luma;
+
+		if(image->channels == 1)
+		{
+			unsigned val;
+
+			if(_pbm_sample(reader, image, &val) != 0)
+			{
+				return -1;
+			}
+
+			luma = val;
+		}
+		else
+		{
+			unsigned r, g, b;
+
+			if(  (_pbm_sample(reader, image, &r) != 0)
+				|| (_pbm_sample(reader, image, &g) != 0)
+				|| (_pbm_sample(reader, image, &b) != 0) )
+			{
+				return -1;
+			}
+
+			// ITU-R BT.601 luma with weights summing up to 256
+			luma = (77*r + 150*g + 29*b + 0x80) >> 8;
+		}
+
+		dst[i] = (luma*0xff + maxval/2) / maxval;
+	}
+
+	return 0;
+}
+
+#define SCALE_BLOCK 64 // columns accumulated at once in vertical pass
+
+static uint64_t
+_scale_inv(unsigned src_len)
+{
+	// 32.32 fixed point reciprocal, replaces per-pixel division
+	return ( (UINT64_C(1) << 32) + src_len/2) / src_len;
+}
+
+static inline uint8_t
+_scale_norm(uint32_t acc, uint64_t inv)
+{
+	const uint32_t val = (acc * inv + 0x80000000) >> 32;
+
+	return val > 0xff ? 0xff : val;
+}
+
+static void
+_scale_line(const uint8_t *src, unsigned src_len, uint8_t *dst,
+	unsigned dst_len, uint64_t inv)
+{
+	// map source and destination onto a common grid of src_len*dst_len
+	// cells, destination pixel covers src_len and source pixel dst_len cells,
+	// step through both with a remainder instead of dividing per pixel
+	uint32_t left = dst_len; // cells of current source pixel not consumed yet
+
+	for(unsigned j = 0; j < dst_len; j++)
+	{
+		uint32_t need = src_len; // cells of destination pixel not covered yet
+		uint32_t acc = 0;
+
+		while(need)
+		{
+			const uint32_t take = left < need ? left : need;
+
+			acc += take * *src;
+			need -= take;
+			left -= take;
+
+			if(left == 0)
+			{
+				src++;
+				left = dst_len;
+			}
+		}
+
+		dst[j] = _scale_norm(acc, inv);
+	}
+}
+
+static void
+_scale_rows(const uint8_t *src, unsigned width, unsigned src_len,
+	uint8_t *dst, unsigned dst_len, uint64_t inv)
+{
+	// same stepping as _scale_line, but whole rows are weighted at once to
+	// keep memory access sequential and inner loops amenable to vectorization
+	for(unsigned x0 = 0; x0 < width; x0 += SCALE_BLOCK)
+	{
+		const unsigned n = (width - x0 < SCALE_BLOCK) ? width - x0 : SCALE_BLOCK;
+		const uint8_t *from = &src[x0];
+		uint32_t left = dst_len;
+
+		for(unsigned j = 0; j < dst_len; j++)
+		{
+			uint32_t acc [SCALE_BLOCK];
+			uint32_t need = src_len;
+			uint8_t *to = &dst[j*width + x0];
+
+			memset(acc, 0x0, n * sizeof(uint32_t));
+
+			while(need)
+			{
+				const uint32_t take = left < need ? left : need;
+
+				for(unsigned k = 0; k < n; k++)
+				{
+					acc[k] += take * from[k];
+				}
+
+				need -= take;
+				left -= take;
+
+				if(left == 0)
+				{
+					from += width;
+					left = dst_len;
+				}
+			}
+
+			for(unsigned k = 0; k < n; k++)
+			{
+				to[k] = _scale_norm(acc[k], inv);
+			}
+		}
+	}
+}
+
+void
+monobus_gray_scale(const uint8_t *src, unsigned src_width, unsigned src_height,
+	uint8_t *dst, unsigned dst_width, unsigned dst_height, uint8_t *tmp)
+{
+	// area-averaging in two separable passes, horizontally into tmp
+	// (dst_width x src_height), then vertically into dst
+	if(src_width == dst_width)
+	{
+		memcpy(tmp, src, dst_width * src_height);
+	}
+	else
+	{
+		const uint64_t inv = _scale_inv(src_width);
+
+		for(unsigned y = 0; y < src_height; y++)
+		{
+			_scale_line(&src[y * src_width], src_width, &tmp[y * dst_width],
+				dst_width, inv);
+		}
+	}
+
+	if(src_height == dst_height)
+	{
+		memcpy(dst, tmp, dst_width * dst_height);
+		return;
+	}
+
+	_scale_rows(tmp, dst_width, src_height, dst, dst_height,
+		_scale_inv(src_height));
+}
+
+// 8x8 Bayer matrix scaled to 8-bit thresholds
+static const uint8_t bayer [8][8] = {
+	{  2, 130,  34, 162,  10, 138,  42, 170},
+	{194,  66, 226,  98, 202,  74, 234, 106},
+	{ 50, 178,  18, 146,  58, 186,  26, 154},
+	{242, 114, 210,  82, 250, 122, 218,  90},
+	{ 14, 142,  46, 174,   6, 134,  38, 166},
+	{206,  78, 238, 110, 198,  70, 230, 102},
+	{ 62, 190,  30, 158,  54, 182,  22, 150},
+	{254, 126, 222,  94, 246, 118, 214,  86}
+};
+
+// plain threshold at mid-gray
+static const uint8_t threshold [1][8] = {
+	{0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80}
+};
+
+static void
+_dither_ordered(const uint8_t *gray, unsigned width, unsigned height,
+	const uint8_t (*thresh)[8], unsigned rows, uint8_t *dst)
+{
+	const unsigned stride = monobus_stride_for_width(width);
+
+	for(unsigned y = 0; y < height; y++)
+	{
+		const uint8_t *from = &gray[y * width];
+		const uint8_t *t = thresh[y % rows];
+		uint8_t *row = &dst[y * stride];
+		unsigned x = 0;
+
+		// branch-free groups of 8 pixels, amenable to auto-vectorization
+		for( ; x + 8 <= width; x += 8)
+		{
+			uint8_t byte = 0;
+
+			for(unsigned k = 0; k < 8; k++)
+			{
+				byte |= (from[x + k] < t[k]) << (7 - k);
+			}
+
+			row[x / 8] = byte;
+		}
+
+		if(x < width)
+		{
+			uint8_t byte = 0;
+
+			for(unsigned k = 0; k < width - x; k++)
+			{
+				byte |= (from[x + k] < t[k]) << (7 - k);
+			}
+
+			row[x / 8] = byte;
+		}
+	}
+}
+
+static void
+_dither_floyd(const uint8_t *gray, unsigned width, unsigned height,
+	int16_t *err, uint8_t *dst)
+{
+	const unsigned stride = monobus_stride_for_width(width);
+
+	// unclamped errors in 1/16 units for current and next row, with a guard
+	// cell on either side to diffuse without bounds checks
+	int16_t *cur = &err[1];
+	int16_t *nxt = &err[width + 3];
+
+	memset(err, 0x0, MONOBUS_DITHER_ERR_LEN(width) * sizeof(int16_t));
+	memset(dst, 0x0, stride * height);
+
+	for(unsigned y = 0; y < height; y++)
+	{
+		const uint8_t *from = &gray[y * width];
+		uint8_t *row = &dst[y * stride];
+		int32_t right = 0; // diffused to next pixel in current row
+
+		for(unsigned x = 0; x < width; x++)
+		{
+			const int32_t val = from[x]*16 + cur[x] + right;
+			const bool on = val < 0x80*16; // dark pixels are set like in PBM
+			const int32_t e = val - (on ? 0x0 : 0xff*16);
+
+			if(on)
+			{
+				row[x / 8] |= 0x80 >> (x % 8);
+			}
+
+			// 7/16, 3/16, 5/16 and the remainder, so no error gets lost
+			const int32_t e7 = e*7 / 16;
+			const int32_t e3 = e*3 / 16;
+			const int32_t e5 = e*5 / 16;
+			int16_t *below = &nxt[x];
+
+			right = e7;
+			below[-1] += e3;
+			below[0] += e5;
+			below[1] += e - e7 - e3 - e5;
+		}
+
+		// next row becomes current one, former current one gets reused
+		int16_t *tmp = cur;
+		cur = nxt;
+		nxt = tmp;
+
+		memset(&nxt[-1], 0x0, (width + 2) * sizeof(int16_t));
+	}
+}
+
+void
+monobus_gray_dither(const uint8_t *gray, unsigned width, unsigned height,
+	dither_t dither, int16_t *err, uint8_t *dst)
+{
+	switch(dither)
+	{
+		case DITHER_THRESHOLD:
+		{
+			_dither_ordered(gray, width, height, threshold, 1, dst);
+		} break;
+		case DITHER_BAYER:
+		{
+			_dither_ordered(gray, width, height, bayer, 8, dst);
+		} break;
+		case DITHER_FLOYD:
+		{
+			_dither_floyd(gray, width, height, err, dst);
+		} break;
+	}
+}
+
+static int
+_font_glyph_new(font_t *font, uint32_t code, size_t bits_len)
+{
+	if(font->nglyphs == font->maxglyphs)
+	{
+		const unsigned maxglyphs = font->maxglyphs ? font->maxglyphs * 2 : 256;
+		font_glyph_t *glyphs = realloc(font->glyphs, maxglyphs * sizeof(font_glyph_t));
+		if(!glyphs)
+		{
+			return -1;
+		}
+
+		font->glyphs = glyphs;
+		font->maxglyphs = maxglyphs;
+	}
+
+	if(!font->bits || (font->bits_len + bits_len > font->maxbits) )
+	{
+		size_t maxbits = font->maxbits ? font->maxbits : 0x1000;
+		while(font->bits_len + bits_len > maxbits)
+		{
+			maxbits *= 2;
+		}
+
+		uint8_t *bits = realloc(font->bits, maxbits);
+		if(!bits)
+		{
+			return -1;
+		}
+
+		font->bits = bits;
+		font->maxbits = maxbits;
+	}
+
+	font_glyph_t *glyph = &font->glyphs[font->nglyphs];
+
+	memset(glyph, 0x0, sizeof(font_glyph_t));
+	glyph->code = code;
+	glyph->offset = font->bits_len;
+
+	memset(&font->bits[font->bits_len], 0x0, bits_len);
+	font->bits_len += bits_len;
+
+	return font->nglyphs++;
+}
+
+static int
+_font_hex(int c)
+{
+	if( (c >= '0') && (c <= '9') )
+	{
+		return c - '0';
+	}
+	else if( (c >= 'a') && (c <= 'f') )
+	{
+		return c - 'a' + 10;
+	}
+	else if( (c >= 'A') && (c <= 'F') )
+	{
+		return c - 'A' + 10;
+	}
+
+	return -1;
+}
+
+static int
+_font_load_bdf(font_t *font, const uint8_t *buf, size_t len)
+{
+	const char *ptr = (const char *)buf;
+	const char *end = ptr + len;
+	int bbx_h = 0;
+	int bbx_y = 0;
+	bool ascent = false;
+	bool descent = false;
+	int idx = -1; // glyph currently parsed
+	int code = -1;
+	int advance = 0;
+	int rows = 0; // remaining bitmap rows
+
+	while(ptr < end)
+	{
+		// copy line to have it zero-terminated for sscanf
+		char line [256];
+		size_t n = 0;
+
+		while( (ptr < end) && (*ptr != '\n') )
+		{
+			if( (n < sizeof(line) - 1) && (*ptr != '\r') )
+			{
+				line[n++] = *ptr;
+			}
+
+			ptr++;
+		}
+
+		line[n] = '\0';
+		ptr++;
+
+		int a, b, c, d;
+
+		if(rows > 0)
+		{
+			font_glyph_t *glyph = &font->glyphs[idx];
+			const unsigned stride = monobus_stride_for_width(glyph->width);
+			uint8_t *row = &font->bits[glyph->offset
+				+ (glyph->height - rows) * stride];
+
+			for(unsigned i = 0; i < stride; i++)
+			{
+				const int hi = _font_hex(line[2*i]);
+				const int lo = (hi == -1) ? -1 : _font_hex(line[2*i + 1]);
+
+				if(lo == -1)
+				{
+					break;
+				}
+
+				row[i] = (hi << 4) | lo;
+			}
+
+			rows--;
+		}
+		else if(sscanf(line, "FONT_ASCENT %d", &a) == 1)
+		{
+			font->ascent = a;
+			ascent = true;
+		}
+		else if(sscanf(line, "FONT_DESCENT %d", &a) == 1)
+		{
+			font->descent = a;
+			descent = true;
+		}
+		else if(sscanf(line, "FONTBOUNDINGBOX %d %d %d %d", &a, &b, &c, &d) == 4)
+		{
+			bbx_h = b;
+			bbx_y = d;
+		}
+		else if(sscanf(line, "DEFAULT_CHAR %d", &a) == 1)
+		{
+			font->fallback = a;
+		}
+		else if(!strncmp(line, "STARTCHAR", 9))
+		{
+			code = -1;
+			advance = 0;
+			idx = -1;
+		}
+		else if(sscanf(line, "ENCODING %d", &a) == 1)
+		{
+			code = a;
+		}
+		else if(sscanf(line, "DWIDTH %d %d", &a, &b) == 2)
+		{
+			advance = a;
+		}
+		else if(sscanf(line, "BBX %d %d %d %d", &a, &b, &c, &d) == 4)
+		{
+			if( (code < 0) || (a < 0) || (b < 0) )
+			{
+				continue; // unencoded glyph
+			}
+
+			// file is untrusted, bound dimensions before sizing bitmap by them
+			if( (a > MONOBUS_GLYPH_MAX) || (b > MONOBUS_GLYPH_MAX) )
+			{
+				return -1;
+			}
+
+			const size_t stride = monobus_stride_for_width(a);
+			if( (b != 0) && (stride > SIZE_MAX / b) )
+			{
+				return -1;
+			}
+
+			idx = _font_glyph_new(font, code, stride * b);
+			if(idx == -1)
+			{
+				return -1;
+			}
+
+			font_glyph_t *glyph = &font->glyphs[idx];
+
+			glyph->advance = advance;
+			glyph->width = a;
+			glyph->height = b;
+			glyph->xoff = c;
+			glyph->yoff = d;
+		}
+		else if(!strncmp(line, "BITMAP", 6))
+		{
+			rows = (idx == -1) ? 0 : font->glyphs[idx].height;
+		}
+	}
+
+	if(!ascent)
+	{
+		font->ascent = bbx_h + bbx_y;
+	}
+
+	if(!descent)
+	{
+		font->descent = -bbx_y;
+	}
+
+	return 0;
+}
+
+#define PCF_ACCELERATORS       (1 << 1)
+#define PCF_METRICS            (1 << 2)
+#define PCF_BITMAPS            (1 << 3)
+#define PCF_BDF_ENCODINGS      (1 << 5)
+#define PCF_BDF_ACCELERATORS   (1 << 8)
+
+#define PCF_COMPRESSED_METRICS 0x100
+#define PCF_BYTE_MASK          (1 << 2)
+#define PCF_BIT_MASK           (1 << 3)
+
+typedef struct _pcf_cursor_t pcf_cursor_t;
+
+struct _pcf_cursor_t {
+	const uint8_t *buf;
+	size_t len;
+	size_t off;
+	uint32_t format;
+	bool err;
+};
+
+static uint32_t
+_pcf_get(pcf_cursor_t *cur, unsigned sz, bool msb)
+{
+	if( (cur->off > cur->len) || (cur->len - cur->off < sz) )
+	{
+		cur->err = true;
+		return 0;
+	}
+
+	const uint8_t *src = &cur->buf[cur->off];
+	uint32_t val = 0;
+
+	for(unsigned i = 0; i < sz; i++)
+	{
+		val |= (uint32_t)src[i] << (8 * (msb ? sz - 1 - i : i));
+	}
+
+	cur->off += sz;
+
+	return val;
+}
+
+static uint32_t
+_pcf_u32(pcf_cursor_t *cur)
+{
+	return _pcf_get(cur, 4, cur->format & PCF_BYTE_MASK);
+}
+
+static uint16_t
+_pcf_u16(pcf_cursor_t *cur)
+{
+	return _pcf_get(cur, 2, cur->format & PCF_BYTE_MASK);
+}
+
+static uint8_t
+_pcf_u8(pcf_cursor_t *cur)
+{
+	return _pcf_get(cur, 1, false);
+}
+
+static int
+_pcf_table(pcf_cursor_t *cur, const uint8_t *buf, size_t len, uint32_t type)
+{
+	pcf_cursor_t toc = {
+		.buf = buf,
+		.len = len,
+		.off = 4 // skip magic
+	};
+
+	// table of contents and table formats are always little-endian
+	const uint32_t count = _pcf_u32(&toc);
+
+	for(uint32_t i = 0; (i < count) && !toc.err; i++)
+	{
+		const uint32_t typ = _pcf_u32(&toc);
+		_pcf_u32(&toc); // format
+		_pcf_u32(&toc); // size
+		const uint32_t offset = _pcf_u32(&toc);
+
+		if(!toc.err && (typ == type) )
+		{
+			cur->buf = buf;
+			cur->len = len;
+			cur->off = offset;
+			cur->format = 0;
+			cur->err = false;
+			cur->format = _pcf_u32(cur);
+
+			return cur->err ? -1 : 0;
+		}
+	}
+
+	return -1;
+}
+
+static int
+_font_load_pcf(font_t *font, const uint8_t *buf, size_t len)
+{
+	pcf_cursor_t cur;
+
+	if(  (_pcf_table(&cur, buf, len, PCF_BDF_ACCELERATORS) == 0)
+		|| (_pcf_table(&cur, buf, len, PCF_ACCELERATORS) == 0) )
+	{
+		cur.off += 8; // skip flags and padding
+		font->ascent = _pcf_u32(&cur);
+		font->descent = _pcf_u32(&cur);
+	}
+
+	// metrics
+	if(_pcf_table(&cur, buf, len, PCF_METRICS) != 0)
+	{
+		return -1;
+	}
+
+	const bool compressed = cur.format & PCF_COMPRESSED_METRICS;
+	const uint32_t nmetrics = compressed ? _pcf_u16(&cur) : _pcf_u32(&cur);
+	const size_t metrics_off = cur.off;
+
+	// bitmaps
+	pcf_cursor_t bmp;
+
+	if(_pcf_table(&bmp, buf, len, PCF_BITMAPS) != 0)
+	{
+		return -1;
+	}
+
+	const uint32_t nbitmaps = _pcf_u32(&bmp);
+	const size_t offsets_off = bmp.off;
+	const size_t data_off = offsets_off + (nbitmaps + 4) * 4;
+	const unsigned pad = 1 << (bmp.format & 0x3);
+	const unsigned unit = 1 << ( (bmp.format >> 4) & 0x3);
+	const bool msb_bit = bmp.format & PCF_BIT_MASK;
+	const bool msb_byte = bmp.format & PCF_BYTE_MASK;
+	const bool swap = (msb_bit != msb_byte) && (unit > 1);
+
+	if(nbitmaps != nmetrics)
+	{
+		return -1;
+	}
+
+	// encodings
+	pcf_cursor_t enc;
+
+	if(_pcf_table(&enc, buf, len, PCF_BDF_ENCODINGS) != 0)
+	{
+		return -1;
+	}
+
+	const uint16_t min2 = _pcf_u16(&enc);
+	const uint16_t max2 = _pcf_u16(&enc);
+	const uint16_t min1 = _pcf_u16(&enc);
+	const uint16_t max1 = _pcf_u16(&enc);
+	font->fallback = _pcf_u16(&enc);
+
+	if( (max2 < min2) || (max1 < min1) )
+	{
+		return -1;
+	}
+
+	const unsigned n2 = max2 - min2 + 1;
+	const unsigned n1 = max1 - min1 + 1;
+
+	for(unsigned i = 0; (i < n1*n2) && !enc.err; i++)
+	{
+		const uint16_t j = _pcf_u16(&enc);
+
+		if( (j == 0xffff) || (j >= nmetrics) )
+		{
+			continue; // no glyph
+		}
+
+		// read metrics of glyph
+		int16_t left, right, width, ascent, descent;
+
+		if(compressed)
+		{
+			cur.off = metrics_off + j*5;
+			left = _pcf_u8(&cur) - 0x80;
+			right = _pcf_u8(&cur) - 0x80;
+			width = _pcf_u8(&cur) - 0x80;
+			ascent = _pcf_u8(&cur) - 0x80;
+			descent = _pcf_u8(&cur) - 0x80;
+		}
+		else
+		{
+			cur.off = metrics_off + j*12;
+			left = _pcf_u16(&cur);
+			right = _pcf_u16(&cur);
+			width = _pcf_u16(&cur);
+			ascent = _pcf_u16(&cur);
+			descent = _pcf_u16(&cur);
+		}
+
+		bmp.off = offsets_off + j*4;
+		const size_t offset = data_off + _pcf_u32(&bmp);
+
+		if( cur.err || bmp.err || (right < left) || (ascent + descent < 0)
+			|| (right - left > MONOBUS_GLYPH_MAX)
+			|| (ascent + descent > MONOBUS_GLYPH_MAX) )
+		{
+			return -1;
+		}
+
+		const unsigned w = right - left;
+		const unsigned h = ascent + descent;
+		const unsigned stride = monobus_stride_for_width(w);
+		const unsigned src_stride = (stride + pad - 1) & ~(pad - 1);
+
+		if( (offset > len) || (len - offset < (size_t)src_stride * h) )
+		{
+			return -1;
+		}
+
+		const uint32_t code = ( (min1 + i/n2) << 8) | (min2 + i%n2);
+		const int idx = _font_glyph_new(font, code, (size_t)stride * h);
+		if(idx == -1)
+		{
+			return -1;
+		}
+
+		font_glyph_t *glyph = &font->glyphs[idx];
+
+		glyph->advance = width;
+		glyph->width = w;
+		glyph->height = h;
+		glyph->xoff = left;
+		glyph->yoff = -descent;
+
+		// convert to PBM layout, e.g. most significant bit and byte first
+		const uint8_t *src = &buf[offset];
+		uint8_t *dst = &font->bits[glyph->offset];
+
+		for(unsigned y = 0; y < h; y++)
+		{
+			for(unsigned x = 0; x < stride; x++)
+			{
+				const unsigned k = swap
+					? (x & ~(unit - 1)) + (unit - 1 - (x & (unit - 1)))
+					: x;
+				uint8_t byte = src[y*src_stride + k];
+
+				if(!msb_bit)
+				{
+					byte = ( (byte & 0xf0) >> 4) | ( (byte & 0x0f) << 4);
+					byte = ( (byte & 0xcc) >> 2) | ( (byte & 0x33) << 2);
+					byte = ( (byte & 0xaa) >> 1) | ( (byte & 0x55) << 1);
+				}
+
+				dst[y*stride + x] = byte;
+			}
+		}
+	}
+
+	return enc.err ? -1 : 0;
+}
+
+static int
+_font_cmp(const void *a, const void *b)
+{
+	const font_glyph_t *glyph_a = a;
+	const font_glyph_t *glyph_b = b;
+
+	return (glyph_a->code > glyph_b->code) - (glyph_a->code < glyph_b->code);
+}
+
+int
+monobus_font_load(font_t *font, const uint8_t *buf, size_t len)
+{
+	memset(font, 0x0, sizeof(font_t));
+	font->fallback = '?';
+
+	int ret = -1;
+
+	if( (len >= 4) && !memcmp(buf, "\1fcp", 4) )
+	{
+		ret = _font_load_pcf(font, buf, len);
+	}
+	else if( (len >= 9) && !memcmp(buf, "STARTFONT", 9) )
+	{
+		ret = _font_load_bdf(font, buf, len);
+	}
+
+	if( (ret != 0) || (font->nglyphs == 0) )
+	{
+		monobus_font_free(font);
+		return -1;
+	}
+
+	qsort(font->glyphs, font->nglyphs, sizeof(font_glyph_t), _font_cmp);
+
+	return 0;
+}
+
+void
+monobus_font_free(font_t *font)
+{
+	free(font->glyphs);
+	free(font->bits);
+	memset(font, 0x0, sizeof(font_t));
+}
+
+const font_glyph_t *
+monobus_font_glyph(const font_t *font, uint32_t code)
+{
+	const font_glyph_t key = {
+		.code = code
+	};
+
+	const font_glyph_t *glyph = bsearch(&key, font->glyphs, font->nglyphs,
+		sizeof(font_glyph_t), _font_cmp);
+
+	if(!glyph && (code != font->fallback) )
+	{
+		return monobus_font_glyph(font, font->fallback);
+	}
+
+	return glyph;
+}
+
+static uint32_t
+_utf8_next(const char **text)
+{
+	const uint8_t *ptr = (const uint8_t *)*text;
+	const uint8_t lead = *ptr++;
+	unsigned cont;
+	uint32_t code;
+
+	if(lead < 0x80)
+	{
+		cont = 0;
+		code = lead;
+	}
+	else if( (lead & 0xe0) == 0xc0)
+	{
+		cont = 1;
+		code = lead & 0x1f;
+	}
+	else if( (lead & 0xf0) == 0xe0)
+	{
+		cont = 2;
+		code = lead & 0x0f;
+	}
+	else if( (lead & 0xf8) == 0xf0)
+	{
+		cont = 3;
+		code = lead & 0x07;
+	}
+	else
+	{
+		cont = 0;
+		code = lead; // invalid lead byte, treat as latin-1
+	}
+
+	for(unsigned i = 0; i < cont; i++, ptr++)
+	{
+		if( (*ptr & 0xc0) != 0x80)
+		{
+			// truncated sequence, treat lead byte as latin-1
+			*text += 1;
+			return lead;
+		}
+
+		code = (code << 6) | (*ptr & 0x3f);
+	}
+
+	*text = (const char *)ptr;
+
+	return code;
+}
+
+static const char *
+_font_wrap(const font_t *font, const char *text, int width, int *line_width,
+	const char **next)
+{
+	// break line at last space or before first overflowing glyph
+	const char *space = NULL;
+	const char *space_next = NULL;
+	int space_width = 0;
+	int w = 0;
+
+	const char *ptr = text;
+	while(*ptr && (*ptr != '\n') )
+	{
+		const char *cur = ptr;
+		const uint32_t code = _utf8_next(&ptr);
+		const font_glyph_t *glyph = monobus_font_glyph(font, code);
+		const int advance = glyph ? glyph->advance : 0;
+
+		if(code == ' ')
+		{
+			space = cur;
+			space_next = ptr;
+			space_width = w;
+		}
+		else if( (w + advance > width) && (cur != text) )
+		{
+			if(space)
+			{
+				*line_width = space_width;
+				*next = space_next;
+				return space;
+			}
+
+			*line_width = w;
+			*next = cur;
+			return cur;
+		}
+
+		w += advance;
+	}
+
+	*line_width = w;
+	*next = *ptr ? ptr + 1 : ptr;
+	return ptr;
+}
+
+static void
+_font_blit(const font_t *font, const font_glyph_t *glyph, int x, int y,
+	unsigned width, unsigned height, uint8_t *dst)
+{
+	const unsigned stride = monobus_stride_for_width(width);
+	const unsigned glyph_stride = monobus_stride_for_width(glyph->width);
+	const uint8_t *bits = &font->bits[glyph->offset];
+
+	// y is the baseline, bitmap extends upwards from its bottom edge
+	const int top = y - glyph->yoff - glyph->height;
+	const int left = x + glyph->xoff;
+
+	for(unsigned j = 0; j < glyph->height; j++)
+	{
+		const int py = top + (int)j;
+
+		if( (py < 0) || (py >= (int)height) )
+		{
+			continue;
+		}
+
+		for(unsigned i = 0; i < glyph->width; i++)
+		{
+			const int px = left + (int)i;
+
+			if( (px < 0) || (px >= (int)width) )
+			{
+				continue;
+			}
+
+			if(bits[j*glyph_stride + i/8] & (0x80 >> (i % 8)) )
+			{
+				dst[py*stride + px/8] |= 0x80 >> (px % 8);
+			}
+		}
+	}
+}
+
+void
+monobus_font_render(const font_t *font, const char *text, align_t align,
+	int spacing, unsigned width, unsigned height, uint8_t *dst)
+{
+	const unsigned stride = monobus_stride_for_width(width);
+	const int line_height = font->ascent + font->descent + spacing;
+
+	memset(dst, 0x0, stride * height);
+
+	// count wrapped lines to center them vertically
+	unsigned nlines = 0;
+	for(const char *ptr = text; *ptr; nlines++)
+	{
+		int line_width;
+
+		_font_wrap(font, ptr, width, &line_width, &ptr);
+	}
+
+	const int total = nlines*line_height - spacing;
+	int y = ((int)height - total) / 2 + font->ascent;
+
+	for(const char *ptr = text; *ptr; y += line_height)
+	{
+		int line_width;
+		const char *next;
+		const char *end = _font_wrap(font, ptr, width, &line_width, &next);
+		int x = 0;
+
+		switch(align)
+		{
+			case ALIGN_LEFT:
+			{
+				x = 0;
+			} break;
+			case ALIGN_CENTER:
+			{
+				x = ((int)width - line_width) / 2;
+			} break;
+			case ALIGN_RIGHT:
+			{
+				x = (int)width - line_width;
+			} break;
+		}
+
+		while(ptr < end)
+		{
+			const font_glyph_t *glyph = monobus_font_glyph(font, _utf8_next(&ptr));
+
+			if(glyph)
+			{
+				_font_blit(font, glyph, x, y, width, height, dst);
+				x += glyph->advance;
+			}
+		}
+
+		ptr = next;
+	}
+}
+
 static const LV2_OSC_Tree tree_priority [32+1]; //FIXME
 
 static void
@@ -21,6 +21,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <syslog.h>
+#include <termios.h>
 
 #include <osc.lv2/reader.h>
 
@@ -35,6 +36,18 @@ extern "C" {
 
 #define WIDTH_NET  (HEIGHT_SER)
 #define HEIGHT_NET (WIDTH_SER)
+#define STRIDE_NET (WIDTH_NET / 8)
+#define LENGTH_NET (STRIDE_NET * HEIGHT_NET)
+
+// bitmap rows packed most significant bit first and padded at their end to
+// full bytes like in PBM since protocol 2, padded at their start before
+#define MONOBUS_PROTOCOL   2
+
+#define MONOBUS_BIN_MAGIC  0x5355424d // 'MBUS' in little-endian
+#define MONOBUS_BIN_HEADER 16
+#define MONOBUS_BIN_STAMP  8
+
+#define MONOBUS_FRAME_MAX  512 // unescaped command, payload and checksum
 
 typedef enum _command_type_t {
 	COMMAND_STATUS     = 0x80,
@@ -44,11 +57,43 @@ typedef enum _command_type_t {
 	COMMAND_LED_OUTPUT = 0xe0
 } command_type_t;
 
+// reply payload to STATUS and OUTPUT commands
+typedef enum _status_type_t {
+	STATUS_ACK         = 0x00,
+	STATUS_NAK         = 0x01  // previous message failed checksum
+} status_type_t;
+
+typedef enum _bin_flag_t {
+	BIN_FLAG_CLEAR     = 0x01, // clear region instead of setting it
+	BIN_FLAG_TIMETAG   = 0x02  // 64-bit NTP timetag follows header
+} bin_flag_t;
+
+typedef enum _dither_t {
+	DITHER_THRESHOLD   = 0, // plain threshold at mid-gray
+	DITHER_BAYER       = 1, // ordered dithering with 8x8 Bayer matrix
+	DITHER_FLOYD       = 2  // Floyd-Steinberg error diffusion
+} dither_t;
+
+// int16_t elements of scratch buffer needed by Floyd-Steinberg dithering
+#define MONOBUS_DITHER_ERR_LEN(width) (2 * ((width) + 2))
+
+typedef enum _align_t {
+	ALIGN_LEFT         = 0,
+	ALIGN_CENTER       = 1,
+	ALIGN_RIGHT        = 2
+} align_t;
+
 typedef struct _payload_led_setup_t payload_led_setup_t;
 typedef struct _payload_led_outset_t payload_led_outset_t;
 typedef struct _payload_led_outdat_t payload_led_outdat_t;
 typedef struct _pixel_t pixel_t;
 typedef struct _state_t state_t;
+typedef struct _bin_update_t bin_update_t;
+typedef struct _pbm_reader_t pbm_reader_t;
+typedef struct _pbm_image_t pbm_image_t;
+typedef struct _font_glyph_t font_glyph_t;
+typedef struct _font_t font_t;
+typedef struct _unframer_t unframer_t;
 
 struct _payload_led_setup_t {
 	uint8_t unknown_00;      // FIXME what is this byte for ?
@@ -96,6 +141,89 @@ struct _state_t {
 	pixel_t pixels [HEIGHT_NET][WIDTH_NET];
 };
 
+/*
+ * native binary layer update, all fields little-endian
+ *
+ *  0  uint32_t magic (MONOBUS_BIN_MAGIC)
+ *  4  uint8_t  layer aka priority 0-31
+ *  5  uint8_t  flags (bin_flag_t)
+ *  6  int16_t  x-offset
+ *  8  int16_t  y-offset
+ * 10  uint16_t width
+ * 12  uint16_t height
+ * 14  uint16_t reserved (0)
+ * 16  uint64_t NTP timetag (only with BIN_FLAG_TIMETAG)
+ * 16|24       bitmap in PBM payload format (not with BIN_FLAG_CLEAR)
+ */
+struct _bin_update_t {
+	uint8_t layer;
+	uint8_t flags;
+	int16_t x;
+	int16_t y;
+	uint16_t width;
+	uint16_t height;
+	uint64_t timetag;
+	const uint8_t *bitmap;
+	size_t len;
+};
+
+// reads PBM/PGM/PPM images from memory-mapped regular files or from pipes
+struct _pbm_reader_t {
+	int fd;
+	uint8_t *map;
+	size_t map_len;
+	const uint8_t *ptr;
+	const uint8_t *end;
+	uint8_t buf [4096];
+};
+
+#define MONOBUS_PNM_MAX 0x2000 // maximal width and height of PNM images
+
+struct _pbm_image_t {
+	bool raw; // P4/P5/P6 aka raw or P1/P2/P3 aka plain format
+	unsigned channels; // 0 for PBM, 1 for PGM, 3 for PPM
+	unsigned maxval; // maximal sample value of PGM and PPM
+	unsigned width;
+	unsigned height;
+	unsigned stride; // of bitmap for PBM, of 8-bit luminance for PGM and PPM
+	size_t len; // of bitmap for PBM, of 8-bit luminance for PGM and PPM
+};
+
+#define MONOBUS_GLYPH_MAX 0x400 // maximal width and height of font glyphs
+
+struct _font_glyph_t {
+	uint32_t code; // character code, e.g. unicode
+	int16_t advance; // horizontal distance to origin of next glyph
+	int16_t xoff; // left edge of bitmap relative to origin
+	int16_t yoff; // bottom edge of bitmap relative to baseline
+	uint16_t width;
+	uint16_t height;
+	size_t offset; // of bitmap in PBM layout into font bits
+};
+
+// bitmap font loaded from BDF or PCF
+struct _font_t {
+	int16_t ascent;
+	int16_t descent;
+	uint32_t fallback; // code of glyph to render for missing ones
+	unsigned nglyphs;
+	unsigned maxglyphs;
+	font_glyph_t *glyphs; // sorted by code
+	size_t bits_len;
+	size_t maxbits;
+	uint8_t *bits;
+};
+
+// incremental decoder of framed messages, fed byte by byte off the wire
+struct _unframer_t {
+	bool framed; // framing byte seen
+	bool escaped; // previous byte was escape
+	uint8_t sum; // checksum of raw bytes so far
+	uint8_t mark; // checksum of raw bytes before last unescaped one
+	size_t len;
+	uint8_t buf [MONOBUS_FRAME_MAX]; // command | id, payload, checksum
+};
+
 extern const LV2_OSC_Tree tree_root [];
 
 uint8_t
@@ -108,6 +236,67 @@ monobus_message(uint8_t *dst, size_t dst_len, uint8_t command, uint8_t id,
 unsigned
 monobus_stride_for_width(unsigned width);
 
+ssize_t
+monobus_bin_encode(uint8_t *dst, size_t dst_len, const bin_update_t *update);
+
+int
+monobus_bin_decode(bin_update_t *update, const uint8_t *src, size_t src_len);
+
+void
+monobus_bin_apply(state_t *state, const bin_update_t *update);
+
+int
+monobus_pbm_init(pbm_reader_t *reader, int fd);
+
+void
+monobus_pbm_deinit(pbm_reader_t *reader);
+
+int
+monobus_pbm_next(pbm_reader_t *reader, pbm_image_t *image);
+
+int
+monobus_pbm_decode(pbm_reader_t *reader, const pbm_image_t *image,
+	uint8_t *dst);
+
+int
+monobus_pbm_decode_gray(pbm_reader_t *reader, const pbm_image_t *image,
+	uint8_t *dst);
+
+void
+monobus_gray_scale(const uint8_t *src, unsigned src_width, unsigned src_height,
+	uint8_t *dst, unsigned dst_width, unsigned dst_height, uint8_t *tmp);
+
+void
+monobus_gray_dither(const uint8_t *gray, unsigned width, unsigned height,
+	dither_t dither, int16_t *err, uint8_t *dst);
+
+int
+monobus_font_load(font_t *font, const uint8_t *buf, size_t len);
+
+void
+monobus_font_free(font_t *font);
+
+const font_glyph_t *
+monobus_font_glyph(const font_t *font, uint32_t code);
+
+void
+monobus_font_render(const font_t *font, const char *text, align_t align,
+	int spacing, unsigned width, unsigned height, uint8_t *dst);
+
+speed_t
+monobus_termios_speed(uint32_t baud);
+
+// OSC/NTP 32.32 timetag as nanoseconds since Unix epoch
+int64_t
+monobus_timetag_ns(uint64_t timetag);
+
+void
+monobus_unframer_reset(unframer_t *unframer);
+
+int
+monobus_unframer_feed(unframer_t *unframer, uint8_t byt, const uint8_t **frame,
+	size_t *len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,606 @@
+/*
+ * Copyright (c) 2019-2020 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <syslog.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <osc.lv2/writer.h>
+#include <osc.lv2/stream.h>
+
+#include <varchunk.h>
+#include <monobus.h>
+#include <monobus_client.h>
+
+#define RX_SIZE 8192
+#define TX_SIZE 0x10000
+#define BUNDLE_SIZE (TX_SIZE / 2)
+#define BACKOFF_MIN_US 100
+#define BACKOFF_MAX_US 10000
+
+struct _monobus_client_t {
+	bool bin;
+	size_t mtu;
+	uint64_t timetag; // of following updates outside of bundles
+
+	LV2_OSC_Stream stream;
+	size_t written; // size of reserved tx ringbuffer chunk
+
+	bool bundled; // explicit bundle is open
+	uint8_t *packet; // reserved tx ringbuffer chunk of bundle
+	LV2_OSC_Writer writer;
+	LV2_OSC_Writer_Frame bndl;
+
+	struct {
+		varchunk_t *rx;
+		varchunk_t *tx;
+	} rb;
+};
+
+static void *
+_write_req(void *data, size_t minimum, size_t *maximum)
+{
+	monobus_client_t *client = data;
+
+	return varchunk_write_request_max(client->rb.rx, minimum, maximum);
+}
+
+static void
+_write_adv(void *data, size_t written)
+{
+	monobus_client_t *client = data;
+
+	varchunk_write_advance(client->rb.rx, written);
+}
+
+static const void *
+_read_req(void *data, size_t *toread)
+{
+	monobus_client_t *client = data;
+
+	return varchunk_read_request(client->rb.tx, toread);
+}
+
+static void
+_read_adv(void *data)
+{
+	monobus_client_t *client = data;
+
+	varchunk_read_advance(client->rb.tx);
+}
+
+static const LV2_OSC_Driver driver = {
+	.write_req = _write_req,
+	.write_adv = _write_adv,
+	.read_req = _read_req,
+	.read_adv = _read_adv
+};
+
+static int
+_drain(monobus_client_t *client)
+{
+	const void *head = NULL;
+	unsigned backoff_us = 0;
+
+	// run stream until tx ringbuffer has been drained
+	while(true)
+	{
+		const LV2_OSC_Enum ev = lv2_osc_stream_run(&client->stream);
+		const int err = ev & LV2_OSC_ERR;
+
+		// full device queue is transient, retry like a full socket buffer
+		if(err && (err != ENOBUFS) )
+		{
+			syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(err));
+			return -1;
+		}
+
+		size_t tosend;
+		const void *next = varchunk_read_request(client->rb.tx, &tosend);
+		if(!next)
+		{
+			return 0;
+		}
+
+		// UDP sockets poll writable even while sends fail, back off instead of
+		// spinning as long as nothing gets sent
+		if(next == head)
+		{
+			backoff_us = backoff_us ? backoff_us * 2 : BACKOFF_MIN_US;
+
+			if(backoff_us > BACKOFF_MAX_US)
+			{
+				backoff_us = BACKOFF_MAX_US;
+			}
+
+			usleep(backoff_us);
+		}
+		else
+		{
+			backoff_us = 0;
+		}
+
+		head = next;
+
+		// wait for socket to be (re)connected or to have room for more
+		struct pollfd fds [2] = {
+			[0] = {
+				.fd = client->stream.sock,
+				.events = POLLOUT,
+				.revents = 0
+			},
+			[1] = {
+				.fd = client->stream.fd,
+				.events = POLLOUT,
+				.revents = 0
+			}
+		};
+
+		if( (poll(fds, 2, 1000) == -1) && (errno != EINTR) )
+		{
+			syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+			return -1;
+		}
+	}
+}
+
+static uint8_t *
+_tx_request(monobus_client_t *client, size_t minimum, size_t *maximum)
+{
+	while(true)
+	{
+		uint8_t *buf = varchunk_write_request_max(client->rb.tx, minimum, maximum);
+		if(buf)
+		{
+			return buf;
+		}
+
+		size_t queued;
+
+		// make room by sending what is queued already
+		if(!varchunk_read_request(client->rb.tx, &queued) || (_drain(client) != 0) )
+		{
+			syslog(LOG_ERR, "varchunk_write_request_max");
+			return NULL;
+		}
+	}
+}
+
+static bool
+_write_msg(LV2_OSC_Writer *writer, uint8_t prio, int32_t x, int32_t y,
+	int32_t width, int32_t height, size_t len, uint8_t **body)
+{
+	char path [32];
+
+	snprintf(path, sizeof(path), "/monobus/%"PRIu8, prio);
+
+	if(!body) // clear layer
+	{
+		return lv2_osc_writer_message_vararg(writer, path, "");
+	}
+
+	if(  !lv2_osc_writer_add_path(writer, path)
+		|| !lv2_osc_writer_add_format(writer, "iiiib")
+		|| !lv2_osc_writer_add_int32(writer, x)
+		|| !lv2_osc_writer_add_int32(writer, y)
+		|| !lv2_osc_writer_add_int32(writer, width)
+		|| !lv2_osc_writer_add_int32(writer, height)
+		|| !lv2_osc_writer_add_blob_inline(writer, len, body) )
+	{
+		return false;
+	}
+
+	// zero blob padding, bitmap itself is filled in by caller
+	memset(&(*body)[len], 0x0, LV2_OSC_PADDED_SIZE(len) - len);
+
+	return true;
+}
+
+static bool
+_write_item(LV2_OSC_Writer *writer, uint64_t timetag, uint8_t prio,
+	int32_t x, int32_t y, int32_t width, int32_t height, size_t len,
+	uint8_t **body)
+{
+	LV2_OSC_Writer_Frame itm;
+	LV2_OSC_Writer_Frame bndl;
+	LV2_OSC_Writer_Frame msg;
+
+	if(timetag == LV2_OSC_IMMEDIATE) // plain message item
+	{
+		return lv2_osc_writer_push_item(writer, &itm)
+			&& _write_msg(writer, prio, x, y, width, height, len, body)
+			&& lv2_osc_writer_pop_item(writer, &itm);
+	}
+
+	// wrap message in its own bundle with given timetag
+	return lv2_osc_writer_push_item(writer, &itm)
+		&& lv2_osc_writer_push_bundle(writer, &bndl, timetag)
+		&& lv2_osc_writer_push_item(writer, &msg)
+		&& _write_msg(writer, prio, x, y, width, height, len, body)
+		&& lv2_osc_writer_pop_item(writer, &msg)
+		&& lv2_osc_writer_pop_bundle(writer, &bndl)
+		&& lv2_osc_writer_pop_item(writer, &itm);
+}
+
+static int
+_packet_begin(monobus_client_t *client, size_t size, uint64_t timetag)
+{
+	size_t sz = 0;
+	client->packet = _tx_request(client, size, &sz);
+	if(!client->packet)
+	{
+		return -1;
+	}
+
+	// updates are packed into an enclosing bundle up to given size
+	lv2_osc_writer_initialize(&client->writer, client->packet, sz);
+
+	if(!lv2_osc_writer_push_bundle(&client->writer, &client->bndl, timetag))
+	{
+		syslog(LOG_ERR, "lv2_osc_writer_push_bundle");
+		client->packet = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+_packet_end(monobus_client_t *client)
+{
+	if(!client->packet)
+	{
+		return;
+	}
+
+	size_t written;
+
+	client->packet = NULL;
+
+	if(  !lv2_osc_writer_pop_bundle(&client->writer, &client->bndl)
+		|| !lv2_osc_writer_finalize(&client->writer, &written) )
+	{
+		return; // empty bundle
+	}
+
+	varchunk_write_advance(client->rb.tx, written);
+}
+
+static int
+_update_packed(monobus_client_t *client, uint8_t prio, int32_t x, int32_t y,
+	int32_t width, int32_t height, size_t len, uint8_t **body)
+{
+	if(!client->packet
+		&& (_packet_begin(client, client->mtu, LV2_OSC_IMMEDIATE) != 0) )
+	{
+		return -1;
+	}
+
+	// limit packet to MTU
+	const LV2_OSC_Writer writer = client->writer;
+	client->writer.end = client->packet + client->mtu;
+
+	if(_write_item(&client->writer, client->timetag, prio, x, y, width, height,
+		len, body))
+	{
+		return 0;
+	}
+
+	// update does not fit, send current packet and start a new one
+	client->writer = writer;
+	_packet_end(client);
+
+	if(_packet_begin(client, client->mtu, LV2_OSC_IMMEDIATE) != 0)
+	{
+		return -1;
+	}
+
+	client->writer.end = client->packet + client->mtu;
+
+	if(!_write_item(&client->writer, client->timetag, prio, x, y, width, height,
+		len, body))
+	{
+		syslog(LOG_ERR, "[%s] 'update exceeds MTU'", __func__);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+_update_begin(monobus_client_t *client, uint8_t prio, int32_t x, int32_t y,
+	int32_t width, int32_t height, size_t len, uint8_t **body)
+{
+	if(client->bundled)
+	{
+		if(!_write_item(&client->writer, LV2_OSC_IMMEDIATE, prio, x, y,
+			width, height, len, body))
+		{
+			syslog(LOG_ERR, "[%s] 'updates exceed bundle size'", __func__);
+			return -1;
+		}
+
+		return 0;
+	}
+
+	if(!client->bin && (client->timetag != LV2_OSC_IMMEDIATE) )
+	{
+		return _update_packed(client, prio, x, y, width, height, len, body);
+	}
+
+	_packet_end(client);
+
+	size_t sz = 0;
+	uint8_t *buf = _tx_request(client, 64 + len, &sz);
+	if(!buf)
+	{
+		return -1;
+	}
+
+	if(client->bin)
+	{
+		const bool timetag = client->timetag != LV2_OSC_IMMEDIATE;
+		const bin_update_t update = {
+			.layer = prio,
+			.flags = (body ? 0 : BIN_FLAG_CLEAR) | (timetag ? BIN_FLAG_TIMETAG : 0),
+			.x = body ? x : 0,
+			.y = body ? y : 0,
+			.width = body ? width : WIDTH_NET,
+			.height = body ? height : HEIGHT_NET,
+			.timetag = client->timetag,
+			.bitmap = NULL, // filled in by caller
+			.len = body ? len : 0
+		};
+
+		const ssize_t written = monobus_bin_encode(buf, sz, &update);
+		if(written < 0)
+		{
+			syslog(LOG_ERR, "monobus_bin_encode");
+			return -1;
+		}
+
+		client->written = written;
+
+		if(body)
+		{
+			*body = buf + written - len;
+		}
+
+		return 0;
+	}
+
+	LV2_OSC_Writer writer;
+
+	lv2_osc_writer_initialize(&writer, buf, sz);
+
+	if(!_write_msg(&writer, prio, x, y, width, height, len, body))
+	{
+		syslog(LOG_ERR, "[%s] 'lv2_osc_writer failed'", __func__);
+		return -1;
+	}
+
+	if(!lv2_osc_writer_finalize(&writer, &client->written))
+	{
+		syslog(LOG_ERR, "lv2_osc_writer_finalize");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+_update_end(monobus_client_t *client)
+{
+	if(client->packet)
+	{
+		return; // packet is sent once full or flushed
+	}
+
+	varchunk_write_advance(client->rb.tx, client->written);
+}
+
+monobus_client_t *
+monobus_client_new(const char *url, bool bin)
+{
+	(void)lv2_osc_stream_pollin; //FIXME
+	(void)lv2_osc_hooks; //FIXME
+
+	monobus_client_t *client = calloc(1, sizeof(monobus_client_t));
+	if(!client)
+	{
+		return NULL;
+	}
+
+	client->bin = bin;
+	client->mtu = MONOBUS_CLIENT_MTU;
+	client->timetag = LV2_OSC_IMMEDIATE;
+
+	client->rb.rx = varchunk_new(RX_SIZE, true);
+	if(!client->rb.rx)
+	{
+		goto failure;
+	}
+
+	client->rb.tx = varchunk_new(TX_SIZE, true);
+	if(!client->rb.tx)
+	{
+		goto failure;
+	}
+
+	if(lv2_osc_stream_init(&client->stream, url, &driver, client) != 0)
+	{
+		syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+		goto failure_stream;
+	}
+
+	return client;
+
+failure_stream:
+	varchunk_free(client->rb.tx);
+failure:
+	if(client->rb.rx)
+	{
+		varchunk_free(client->rb.rx);
+	}
+
+	free(client);
+	return NULL;
+}
+
+void
+monobus_client_free(monobus_client_t *client)
+{
+	monobus_client_bundle_abort(client);
+	monobus_client_flush(client);
+
+	lv2_osc_stream_deinit(&client->stream);
+	varchunk_free(client->rb.rx);
+	varchunk_free(client->rb.tx);
+	free(client);
+}
+
+void
+monobus_client_set_mtu(monobus_client_t *client, size_t mtu)
+{
+	_packet_end(client);
+
+	client->mtu = mtu;
+}
+
+void
+monobus_client_set_timetag(monobus_client_t *client, uint64_t timetag)
+{
+	client->timetag = timetag;
+}
+
+uint8_t *
+monobus_client_layer_begin(monobus_client_t *client, uint8_t prio,
+	int32_t x, int32_t y, int32_t width, int32_t height)
+{
+	const size_t len = monobus_stride_for_width(width) * height;
+	uint8_t *body = NULL;
+
+	if(_update_begin(client, prio, x, y, width, height, len, &body) != 0)
+	{
+		return NULL;
+	}
+
+	return body;
+}
+
+int
+monobus_client_layer_end(monobus_client_t *client)
+{
+	_update_end(client);
+
+	return 0;
+}
+
+int
+monobus_client_set_layer(monobus_client_t *client, uint8_t prio,
+	int32_t x, int32_t y, int32_t width, int32_t height, const uint8_t *bitmap)
+{
+	uint8_t *body = monobus_client_layer_begin(client, prio, x, y, width, height);
+	if(!body)
+	{
+		return -1;
+	}
+
+	memcpy(body, bitmap, monobus_stride_for_width(width) * height);
+
+	return monobus_client_layer_end(client);
+}
+
+int
+monobus_client_clear_layer(monobus_client_t *client, uint8_t prio)
+{
+	if(_update_begin(client, prio, 0, 0, 0, 0, 0, NULL) != 0)
+	{
+		return -1;
+	}
+
+	_update_end(client);
+
+	return 0;
+}
+
+int
+monobus_client_bundle_begin(monobus_client_t *client, uint64_t timetag)
+{
+	if(client->bin || client->bundled)
+	{
+		return -1;
+	}
+
+	_packet_end(client);
+
+	// whole bundle must fit into one packet
+	const size_t size = (client->mtu < BUNDLE_SIZE) ? client->mtu : BUNDLE_SIZE;
+
+	if(_packet_begin(client, size, timetag) != 0)
+	{
+		return -1;
+	}
+
+	client->writer.end = client->packet + size;
+	client->bundled = true;
+
+	return 0;
+}
+
+int
+monobus_client_bundle_commit(monobus_client_t *client)
+{
+	if(!client->bundled)
+	{
+		return -1;
+	}
+
+	client->bundled = false;
+	_packet_end(client);
+
+	return 0;
+}
+
+void
+monobus_client_bundle_abort(monobus_client_t *client)
+{
+	if(!client->bundled)
+	{
+		return;
+	}
+
+	// reserved tx ringbuffer chunk is simply not advanced
+	client->bundled = false;
+	client->packet = NULL;
+}
+
+int
+monobus_client_flush(monobus_client_t *client)
+{
+	if(!client->bundled) // open bundle is sent once committed
+	{
+		_packet_end(client);
+	}
+
+	return _drain(client);
+}
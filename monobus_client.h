@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2019-2020 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#ifndef _MONOBUS_CLIENT_H
+#define _MONOBUS_CLIENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__) && (__GNUC__ >= 4)
+#	define MONOBUS_CLIENT_API __attribute__((visibility("default")))
+#else
+#	define MONOBUS_CLIENT_API
+#endif
+
+#define MONOBUS_CLIENT_IMMEDIATE 1ULL // OSC timetag to apply updates right away
+#define MONOBUS_CLIENT_MTU       1472 // UDP payload on Ethernet
+
+typedef struct _monobus_client_t monobus_client_t;
+
+/*
+ * Persistent connection to monobusd.
+ *
+ * Updates are serialized straight into a preallocated ringbuffer and sent by
+ * monobus_client_flush, or whenever the ringbuffer runs full, no heap is
+ * allocated per call. Functions returning int return 0 on success and -1 on
+ * failure.
+ */
+
+// connect to OSC URI, e.g. osc.udp://localhost:7777, with native binary
+// protocol instead of OSC if bin is set
+MONOBUS_CLIENT_API monobus_client_t *
+monobus_client_new(const char *url, bool bin);
+
+// flush pending updates and disconnect
+MONOBUS_CLIENT_API void
+monobus_client_free(monobus_client_t *client);
+
+// maximal size of packets which timetagged updates are packed into
+MONOBUS_CLIENT_API void
+monobus_client_set_mtu(monobus_client_t *client, size_t mtu);
+
+// timetag of following updates outside of bundles, MONOBUS_CLIENT_IMMEDIATE
+// by default, timetagged updates are each wrapped in their own bundle
+MONOBUS_CLIENT_API void
+monobus_client_set_timetag(monobus_client_t *client, uint64_t timetag);
+
+// reserve bitmap of layer update in PBM payload format to be filled in by
+// caller before monobus_client_layer_end, returns NULL on failure
+MONOBUS_CLIENT_API uint8_t *
+monobus_client_layer_begin(monobus_client_t *client, uint8_t prio,
+	int32_t x, int32_t y, int32_t width, int32_t height);
+
+MONOBUS_CLIENT_API int
+monobus_client_layer_end(monobus_client_t *client);
+
+// set layer to given bitmap in PBM payload format
+MONOBUS_CLIENT_API int
+monobus_client_set_layer(monobus_client_t *client, uint8_t prio,
+	int32_t x, int32_t y, int32_t width, int32_t height, const uint8_t *bitmap);
+
+MONOBUS_CLIENT_API int
+monobus_client_clear_layer(monobus_client_t *client, uint8_t prio);
+
+// collect following updates in one bundle applied within the same beat, not
+// available with native binary protocol, updates fail once bundle exceeds MTU
+MONOBUS_CLIENT_API int
+monobus_client_bundle_begin(monobus_client_t *client, uint64_t timetag);
+
+MONOBUS_CLIENT_API int
+monobus_client_bundle_commit(monobus_client_t *client);
+
+// discard all updates since monobus_client_bundle_begin
+MONOBUS_CLIENT_API void
+monobus_client_bundle_abort(monobus_client_t *client);
+
+// block until all pending updates but an open bundle have been sent
+MONOBUS_CLIENT_API int
+monobus_client_flush(monobus_client_t *client);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //_MONOBUS_CLIENT_H
@@ -17,6 +17,9 @@
 
 #include <assert.h>
 #include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 #include <monobus.h>
 
@@ -212,6 +215,124 @@ _test_crc8()
 	}
 }
 
+static int
+_test_unframe(unframer_t *unframer, const uint8_t *buf, size_t len,
+	const uint8_t **frame, size_t *frame_len)
+{
+	int ret = 0;
+
+	for(size_t i = 0; i < len; i++)
+	{
+		const int status = monobus_unframer_feed(unframer, buf[i], frame, frame_len);
+
+		if(status != 0)
+		{
+			assert(ret == 0);
+			ret = status;
+		}
+	}
+
+	return ret;
+}
+
+static void
+_test_unframer()
+{
+	unframer_t unframer;
+	const uint8_t *frame;
+	size_t len;
+	uint8_t dst [64];
+
+	monobus_unframer_reset(&unframer);
+
+	// test round-trip of payload with bytes needing escape
+	{
+		const uint8_t payload [] = {
+			0x7e, 0x01, 0x7d, 0x02, 0x5e, 0x5d
+		};
+
+		const ssize_t sz = monobus_message(dst, sizeof(dst), COMMAND_LED_OUTDAT,
+			0x2, payload, sizeof(payload));
+		assert(sz > (ssize_t)sizeof(payload) + 3);
+
+		assert(_test_unframe(&unframer, dst, sz, &frame, &len) == 1);
+		assert(len == sizeof(payload) + 1);
+		assert(frame[0] == (COMMAND_LED_OUTDAT | 0x2));
+		assert(memcmp(&frame[1], payload, sizeof(payload)) == 0);
+	}
+
+	// test back-to-back messages without payload, with leading garbage
+	{
+		monobus_unframer_reset(&unframer);
+
+		dst[0] = 0x42;
+		ssize_t sz = 1;
+		sz += monobus_message(&dst[sz], sizeof(dst) - sz, COMMAND_STATUS, 0x2,
+			NULL, 0);
+
+		assert(_test_unframe(&unframer, dst, sz, &frame, &len) == 1);
+		assert(len == 1);
+		assert(frame[0] == (COMMAND_STATUS | 0x2));
+
+		sz = monobus_message(dst, sizeof(dst), COMMAND_LED_OUTPUT, 0x2, NULL, 0);
+		assert(_test_unframe(&unframer, dst, sz, &frame, &len) == 1);
+		assert(frame[0] == (COMMAND_LED_OUTPUT | 0x2));
+	}
+
+	// test checksum mismatch
+	{
+		const uint8_t payload [] = {
+			0x1, 0x2, 0x3
+		};
+
+		monobus_unframer_reset(&unframer);
+
+		const ssize_t sz = monobus_message(dst, sizeof(dst), COMMAND_LED_OUTSET,
+			0x2, payload, sizeof(payload));
+		dst[2] ^= 0x10; // flip bit of first payload byte
+
+		assert(_test_unframe(&unframer, dst, sz, &frame, &len) == -1);
+	}
+
+	// test checksum which needs escape
+	for(uint8_t byt = 0; byt < 0xff; byt++)
+	{
+		monobus_unframer_reset(&unframer);
+
+		const ssize_t sz = monobus_message(dst, sizeof(dst), COMMAND_STATUS, 0x2,
+			&byt, 1);
+
+		assert(_test_unframe(&unframer, dst, sz, &frame, &len) == 1);
+		assert(len == 2);
+		assert(frame[1] == byt);
+	}
+}
+
+static void
+_test_termios_speed()
+{
+	assert(monobus_termios_speed(19200) == B19200);
+	assert(monobus_termios_speed(115200) == B115200);
+	assert(monobus_termios_speed(921600) == B921600);
+	assert(monobus_termios_speed(0) == B0);
+	assert(monobus_termios_speed(12345) == B0);
+}
+
+static void
+_test_timetag_ns()
+{
+	const uint64_t jan_1970 = 2208988800ULL;
+
+	assert(monobus_timetag_ns(jan_1970 << 32) == 0);
+	assert(monobus_timetag_ns( ((jan_1970 + 1) << 32) | 0x80000000) == 1500000000LL);
+	assert(monobus_timetag_ns( (jan_1970 << 32) | 0x1) == 0); // 0.23ns
+	assert(monobus_timetag_ns( (jan_1970 << 32) | 0x5) == 1); // 1.16ns
+	assert(monobus_timetag_ns( (jan_1970 << 32) | 0xffffffff) == 1000000000LL);
+	assert(monobus_timetag_ns( (jan_1970 - 1) << 32) == -1000000000LL);
+	assert(monobus_timetag_ns(0xe8000000ULL << 32) == (0xe8000000LL - 2208988800LL)
+		* 1000000000LL);
+}
+
 static void
 _test_stride()
 {
@@ -237,13 +358,623 @@ _test_stride()
 	assert(monobus_stride_for_width(17) == 3);
 }
 
+static void
+_test_bin()
+{
+	uint8_t bitmap [LENGTH_SER];
+	uint8_t buf [MONOBUS_BIN_HEADER + MONOBUS_BIN_STAMP + LENGTH_SER];
+	state_t state;
+	bin_update_t update;
+
+	for(unsigned i = 0; i < sizeof(bitmap); i++)
+	{
+		bitmap[i] = i;
+	}
+
+	// test encoding/decoding of bitmap with timetag
+	{
+		const bin_update_t ref = {
+			.layer = 5,
+			.flags = BIN_FLAG_TIMETAG,
+			.x = -2,
+			.y = 3,
+			.width = WIDTH_NET,
+			.height = HEIGHT_NET,
+			.timetag = 0x0123456789abcdefULL,
+			.bitmap = bitmap,
+			.len = sizeof(bitmap)
+		};
+
+		const ssize_t len = monobus_bin_encode(buf, sizeof(buf), &ref);
+		assert(len == sizeof(buf));
+
+		// header is little-endian
+		assert(buf[0] == 'M');
+		assert(buf[1] == 'B');
+		assert(buf[2] == 'U');
+		assert(buf[3] == 'S');
+		assert(buf[6] == 0xfe);
+		assert(buf[7] == 0xff);
+		assert(buf[16] == 0xef);
+		assert(buf[23] == 0x01);
+
+		assert(monobus_bin_decode(&update, buf, len) == 0);
+		assert(update.layer == ref.layer);
+		assert(update.flags == ref.flags);
+		assert(update.x == ref.x);
+		assert(update.y == ref.y);
+		assert(update.width == ref.width);
+		assert(update.height == ref.height);
+		assert(update.timetag == ref.timetag);
+		assert(update.len == ref.len);
+		assert(memcmp(update.bitmap, bitmap, sizeof(bitmap)) == 0);
+
+		// truncated timetag, truncated bitmap, bitmap claimed way past buffer
+		assert(monobus_bin_decode(&update, buf, MONOBUS_BIN_HEADER + 4) == -1);
+		assert(monobus_bin_decode(&update, buf, len - 1) == -1);
+		buf[10] = buf[11] = buf[12] = buf[13] = 0xff;
+		assert(monobus_bin_decode(&update, buf, len) == -1);
+
+		// too small buffer, wrong magic
+		assert(monobus_bin_encode(buf, len - 1, &ref) == -1);
+		buf[0] = 'X';
+		assert(monobus_bin_decode(&update, buf, len) == -1);
+	}
+
+	// test setting and clearing bitmap
+	{
+		const bin_update_t set = {
+			.layer = 1,
+			.width = WIDTH_NET,
+			.height = HEIGHT_NET,
+			.bitmap = bitmap,
+			.len = sizeof(bitmap)
+		};
+		const bin_update_t clr = {
+			.layer = 1,
+			.flags = BIN_FLAG_CLEAR,
+			.width = WIDTH_NET,
+			.height = HEIGHT_NET
+		};
+
+		const ssize_t len = monobus_bin_encode(buf, sizeof(buf), &clr);
+		assert(len == MONOBUS_BIN_HEADER);
+		assert(monobus_bin_decode(&update, buf, len) == 0);
+		assert(update.bitmap == NULL);
+
+		memset(&state, 0x0, sizeof(state));
+		monobus_bin_apply(&state, &set);
+
+		for(unsigned y = 0; y < HEIGHT_NET; y++)
+		{
+			for(unsigned x = 0; x < WIDTH_NET; x++)
+			{
+				assert(state.pixels[y][x].mask == 0x2);
+			}
+		}
+
+		monobus_bin_apply(&state, &update);
+
+		for(unsigned y = 0; y < HEIGHT_NET; y++)
+		{
+			for(unsigned x = 0; x < WIDTH_NET; x++)
+			{
+				assert(state.pixels[y][x].mask == 0x0);
+			}
+		}
+	}
+}
+
+static void
+_test_pbm_images(int fd)
+{
+	pbm_reader_t reader;
+	pbm_image_t image;
+	uint8_t bitmap [4];
+
+	assert(monobus_pbm_init(&reader, fd) == 0);
+
+	// plain image with comments and missing whitespace between pixels
+	assert(monobus_pbm_next(&reader, &image) == 1);
+	assert(image.raw == false);
+	assert(image.width == 10);
+	assert(image.height == 2);
+	assert(image.stride == 2);
+	assert(image.len == 4);
+	assert(monobus_pbm_decode(&reader, &image, bitmap) == 0);
+	assert(bitmap[0] == 0x80);
+	assert(bitmap[1] == 0x40);
+	assert(bitmap[2] == 0x01);
+	assert(bitmap[3] == 0x80);
+
+	// raw image
+	assert(monobus_pbm_next(&reader, &image) == 1);
+	assert(image.raw == true);
+	assert(image.width == 16);
+	assert(image.height == 2);
+	assert(image.len == 4);
+	assert(monobus_pbm_decode(&reader, &image, bitmap) == 0);
+	assert(bitmap[0] == 0xde);
+	assert(bitmap[1] == 0xad);
+	assert(bitmap[2] == 0xbe);
+	assert(bitmap[3] == 0xef);
+
+	// end of file
+	assert(monobus_pbm_next(&reader, &image) == 0);
+
+	monobus_pbm_deinit(&reader);
+}
+
+static void
+_test_pbm()
+{
+	static const char pbm [] =
+		"P1\n# comment\n10 2\n"
+		"1000000001\n"
+		"0000000110\n"
+		"P4 16 2\n"
+		"\xde\xad\xbe\xef";
+	const size_t len = sizeof(pbm) - 1;
+
+	// test reading from memory-mapped regular file
+	{
+		char path [] = "/tmp/monobus_test_XXXXXX";
+		const int fd = mkstemp(path);
+		assert(fd != -1);
+		assert(write(fd, pbm, len) == (ssize_t)len);
+
+		_test_pbm_images(fd);
+
+		close(fd);
+		unlink(path);
+	}
+
+	// test reading from pipe
+	{
+		int fds [2];
+		assert(pipe(fds) == 0);
+		assert(write(fds[1], pbm, len) == (ssize_t)len);
+		close(fds[1]);
+
+		_test_pbm_images(fds[0]);
+
+		close(fds[0]);
+	}
+}
+
+static void
+_test_pnm()
+{
+	static const char pnm [] =
+		"P2\n3 1\n# comment\n100\n0 50 100\n"
+		"P6 2 1 255\n\xff\x00\x00\x00\x00\xff"
+		"P5 1 1 65535\n\x80\x00";
+	const size_t len = sizeof(pnm) - 1;
+
+	int fds [2];
+	assert(pipe(fds) == 0);
+	assert(write(fds[1], pnm, len) == (ssize_t)len);
+	close(fds[1]);
+
+	pbm_reader_t reader;
+	pbm_image_t image;
+	uint8_t gray [3];
+
+	assert(monobus_pbm_init(&reader, fds[0]) == 0);
+
+	// plain graymap with non-8-bit maxval
+	assert(monobus_pbm_next(&reader, &image) == 1);
+	assert(image.raw == false);
+	assert(image.channels == 1);
+	assert(image.maxval == 100);
+	assert(image.width == 3);
+	assert(image.height == 1);
+	assert(image.len == 3);
+	assert(monobus_pbm_decode(&reader, &image, gray) == -1);
+	assert(monobus_pbm_decode_gray(&reader, &image, gray) == 0);
+	assert(gray[0] == 0x00);
+	assert(gray[1] == 0x80);
+	assert(gray[2] == 0xff);
+
+	// raw pixmap
+	assert(monobus_pbm_next(&reader, &image) == 1);
+	assert(image.raw == true);
+	assert(image.channels == 3);
+	assert(image.len == 2);
+	assert(monobus_pbm_decode_gray(&reader, &image, gray) == 0);
+	assert(gray[0] == 77);
+	assert(gray[1] == 29);
+
+	// raw graymap with 16-bit samples
+	assert(monobus_pbm_next(&reader, &image) == 1);
+	assert(image.maxval == 0xffff);
+	assert(monobus_pbm_decode_gray(&reader, &image, gray) == 0);
+	assert(gray[0] == 0x80);
+
+	assert(monobus_pbm_next(&reader, &image) == 0);
+
+	monobus_pbm_deinit(&reader);
+	close(fds[0]);
+
+	// untrusted headers with excessive or overflowing dimensions
+	static const char *const huge [] = {
+		"P4 4294967295 2\n",
+		"P4 42949672960 1\n",
+		"P5 100000 100000 255\n",
+		"P6 8193 1 255\n"
+	};
+
+	for(unsigned i = 0; i < sizeof(huge) / sizeof(*huge); i++)
+	{
+		assert(pipe(fds) == 0);
+		assert(write(fds[1], huge[i], strlen(huge[i])) == (ssize_t)strlen(huge[i]));
+		close(fds[1]);
+
+		assert(monobus_pbm_init(&reader, fds[0]) == 0);
+		assert(monobus_pbm_next(&reader, &image) == -1);
+
+		monobus_pbm_deinit(&reader);
+		close(fds[0]);
+	}
+}
+
+static void
+_test_scale()
+{
+	uint8_t tmp [8];
+	uint8_t dst [8];
+
+	// downscale by integer factor
+	{
+		const uint8_t src [2*4] = {
+			0x00, 0x10, 0x20, 0x40,
+			0x20, 0x30, 0x60, 0x80
+		};
+
+		monobus_gray_scale(src, 4, 2, dst, 2, 1, tmp);
+		assert(dst[0] == 0x18);
+		assert(dst[1] == 0x50);
+	}
+
+	// downscale by fractional factor
+	{
+		const uint8_t src [3] = { 0x00, 0x30, 0x60 };
+
+		monobus_gray_scale(src, 3, 1, dst, 2, 1, tmp);
+		assert(dst[0] == 0x10); // (2*0x00 + 1*0x30) / 3
+		assert(dst[1] == 0x50); // (1*0x30 + 2*0x60) / 3
+	}
+
+	// upscale
+	{
+		const uint8_t src [2] = { 0x00, 0xff };
+
+		monobus_gray_scale(src, 1, 2, dst, 2, 4, tmp);
+		assert(dst[0] == 0x00);
+		assert(dst[1] == 0x00);
+		assert(dst[2] == 0x00);
+		assert(dst[3] == 0x00);
+		assert(dst[4] == 0xff);
+		assert(dst[5] == 0xff);
+		assert(dst[6] == 0xff);
+		assert(dst[7] == 0xff);
+	}
+
+	// fixed point stepping matches exact area-averaging, also across blocks
+	{
+		static uint8_t src [3*150];
+		static uint8_t ref [2*70];
+		static uint8_t out [2*70];
+		static uint8_t tmp2 [3*70];
+
+		for(unsigned i = 0; i < sizeof(src); i++)
+		{
+			src[i] = (i * 37) ^ (i >> 3);
+		}
+
+		for(unsigned y = 0; y < 2; y++)
+		{
+			for(unsigned x = 0; x < 70; x++)
+			{
+				// destination pixel covers 15/7 x 3/2 source pixels
+				uint64_t acc = 0;
+
+				for(unsigned v = 0; v < 3; v++)
+				{
+					const uint64_t wy = (v == 1) ? 1 : (v == 0 ? 2*(1 - y) : 2*y);
+
+					for(unsigned u = 0; u < 150; u++)
+					{
+						const uint64_t lo = x * 150;
+						const uint64_t hi = lo + 150;
+						const uint64_t beg = u * 70;
+						const uint64_t end = beg + 70;
+						const uint64_t wx = (end > lo) && (beg < hi)
+							? (end < hi ? end : hi) - (beg > lo ? beg : lo)
+							: 0;
+
+						acc += wx * wy * src[v*150 + u];
+					}
+				}
+
+				ref[y*70 + x] = (acc + 150*3/2) / (150*3);
+			}
+		}
+
+		monobus_gray_scale(src, 150, 3, out, 70, 2, tmp2);
+
+		for(unsigned i = 0; i < sizeof(out); i++)
+		{
+			assert(abs(out[i] - ref[i]) <= 1);
+		}
+	}
+}
+
+static unsigned
+_count_bits(const uint8_t *bitmap, size_t len)
+{
+	unsigned cnt = 0;
+
+	for(size_t i = 0; i < len; i++)
+	{
+		for(uint8_t mask = 0x80; mask; mask >>= 1)
+		{
+			if(bitmap[i] & mask)
+			{
+				cnt++;
+			}
+		}
+	}
+
+	return cnt;
+}
+
+static void
+_test_dither()
+{
+#define W 20
+#define H 8
+	const unsigned stride = monobus_stride_for_width(W);
+	uint8_t gray [W*H];
+	uint8_t bitmap [3*H];
+	int16_t err [MONOBUS_DITHER_ERR_LEN(W)];
+
+	assert(stride == 3);
+
+	for(dither_t dither = DITHER_THRESHOLD; dither <= DITHER_FLOYD; dither++)
+	{
+		// black sets all pixels
+		memset(gray, 0x00, sizeof(gray));
+		memset(bitmap, 0x55, sizeof(bitmap));
+		monobus_gray_dither(gray, W, H, dither, err, bitmap);
+		assert(_count_bits(bitmap, sizeof(bitmap)) == W*H);
+		for(unsigned y = 0; y < H; y++)
+		{
+			assert(bitmap[y*stride + 2] == 0xf0); // padding is cleared
+		}
+
+		// white clears all pixels
+		memset(gray, 0xff, sizeof(gray));
+		monobus_gray_dither(gray, W, H, dither, err, bitmap);
+		assert(_count_bits(bitmap, sizeof(bitmap)) == 0);
+
+		// mid-gray sets about half of the pixels, except for threshold
+		memset(gray, 0x7f, sizeof(gray));
+		monobus_gray_dither(gray, W, H, dither, err, bitmap);
+
+		const unsigned cnt = _count_bits(bitmap, sizeof(bitmap));
+		if(dither == DITHER_THRESHOLD)
+		{
+			assert(cnt == W*H);
+		}
+		else
+		{
+			assert( (cnt >= W*H/2 - W/2) && (cnt <= W*H/2 + W/2) );
+		}
+	}
+#undef W
+#undef H
+
+	// error diffusion keeps mean intensity next to saturation
+	{
+#define W 64
+#define H 64
+		static uint8_t dark [W*H];
+		static uint8_t bits [8*H];
+		int16_t err [MONOBUS_DITHER_ERR_LEN(W)];
+
+		memset(dark, 0x08, sizeof(dark));
+		for(unsigned x = 0; x < W*H; x += 2)
+		{
+			dark[x] = 0x00; // saturated pixels interleaved
+		}
+
+		monobus_gray_dither(dark, W, H, DITHER_FLOYD, err, bits);
+
+		// past initial build-up of error, W*H/4 pixels of 0x08 in bottom half
+		// add up to W*H/4 * 0x08/0xff = 32 unset ones
+		const unsigned off = W*H/2 - _count_bits(&bits[8*H/2], 8*H/2);
+		assert( (off >= 32 - 8) && (off <= 32 + 8) );
+#undef W
+#undef H
+	}
+}
+
+static const char bdf [] =
+	"STARTFONT 2.1\n"
+	"FONT test\n"
+	"FONTBOUNDINGBOX 3 3 0 -1\n"
+	"STARTPROPERTIES 2\n"
+	"FONT_ASCENT 2\n"
+	"FONT_DESCENT 1\n"
+	"ENDPROPERTIES\n"
+	"CHARS 3\n"
+	"STARTCHAR space\n"
+	"ENCODING 32\n"
+	"DWIDTH 4 0\n"
+	"BBX 0 0 0 0\n"
+	"BITMAP\n"
+	"ENDCHAR\n"
+	"STARTCHAR A\n"
+	"ENCODING 65\n"
+	"DWIDTH 4 0\n"
+	"BBX 3 3 0 -1\n"
+	"BITMAP\n"
+	"A0\n"
+	"40\n"
+	"E0\n"
+	"ENDCHAR\n"
+	"STARTCHAR unencoded\n"
+	"ENCODING -1\n"
+	"DWIDTH 4 0\n"
+	"BBX 3 3 0 -1\n"
+	"BITMAP\n"
+	"E0\n"
+	"E0\n"
+	"E0\n"
+	"ENDCHAR\n"
+	"ENDFONT\n";
+
+// same glyph 'A' with least significant bit first and rows padded to 32 bits
+static const uint8_t pcf [] = {
+	0x01, 'f', 'c', 'p',
+	0x04, 0x00, 0x00, 0x00, // table count
+
+	0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // accelerators
+	0x14, 0x00, 0x00, 0x00, 0x48, 0x00, 0x00, 0x00,
+	0x04, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, // metrics
+	0x0b, 0x00, 0x00, 0x00, 0x5c, 0x00, 0x00, 0x00,
+	0x08, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, // bitmaps
+	0x28, 0x00, 0x00, 0x00, 0x68, 0x00, 0x00, 0x00,
+	0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // encodings
+	0x12, 0x00, 0x00, 0x00, 0x90, 0x00, 0x00, 0x00,
+
+	0x00, 0x00, 0x00, 0x00, // accelerators @ 0x48
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x02, 0x00, 0x00, 0x00, // ascent
+	0x01, 0x00, 0x00, 0x00, // descent
+
+	0x00, 0x01, 0x00, 0x00, // compressed metrics @ 0x5c
+	0x01, 0x00,
+	0x80, 0x83, 0x84, 0x82, 0x81,
+	0x00, // padding
+
+	0x02, 0x00, 0x00, 0x00, // bitmaps @ 0x68
+	0x01, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, // offsets
+	0x03, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, // sizes
+	0x0c, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00,
+	0x05, 0x00, 0x00, 0x00,
+	0x02, 0x00, 0x00, 0x00,
+	0x07, 0x00, 0x00, 0x00,
+
+	0x00, 0x00, 0x00, 0x00, // encodings @ 0x90
+	0x41, 0x00, 0x42, 0x00, 0x00, 0x00, 0x00, 0x00, 0x42, 0x00,
+	0x00, 0x00, 0xff, 0xff
+};
+
+static void
+_test_font_glyph(const font_t *font)
+{
+	const font_glyph_t *glyph = monobus_font_glyph(font, 'A');
+
+	assert(font->ascent == 2);
+	assert(font->descent == 1);
+	assert(glyph);
+	assert(glyph->code == 'A');
+	assert(glyph->advance == 4);
+	assert(glyph->width == 3);
+	assert(glyph->height == 3);
+	assert(glyph->xoff == 0);
+	assert(glyph->yoff == -1);
+	assert(font->bits[glyph->offset + 0] == 0xa0);
+	assert(font->bits[glyph->offset + 1] == 0x40);
+	assert(font->bits[glyph->offset + 2] == 0xe0);
+}
+
+static void
+_test_font()
+{
+	font_t font;
+	uint8_t bitmap [2*6];
+
+	assert(monobus_font_load(&font, (const uint8_t *)"garbage", 7) == -1);
+
+	// PCF
+	assert(monobus_font_load(&font, pcf, sizeof(pcf)) == 0);
+	assert(font.nglyphs == 1);
+	assert(font.fallback == 'B');
+	_test_font_glyph(&font);
+	assert(monobus_font_glyph(&font, 'Z') == NULL);
+	monobus_font_free(&font);
+
+	// BDF
+	assert(monobus_font_load(&font, (const uint8_t *)bdf, sizeof(bdf) - 1) == 0);
+	assert(font.nglyphs == 2);
+	_test_font_glyph(&font);
+	assert(monobus_font_glyph(&font, 'Z') == NULL); // neither has '?'
+	font.fallback = 'A';
+	assert(monobus_font_glyph(&font, 'Z')->code == 'A');
+
+	// centered
+	monobus_font_render(&font, "A", ALIGN_CENTER, 0, 8, 3, bitmap);
+	assert(bitmap[0] == 0x28);
+	assert(bitmap[1] == 0x10);
+	assert(bitmap[2] == 0x38);
+
+	// right-aligned
+	monobus_font_render(&font, "A", ALIGN_RIGHT, 0, 8, 3, bitmap);
+	assert(bitmap[0] == 0x0a);
+
+	// wrapped at last space which fits, left-aligned
+	monobus_font_render(&font, "A A A", ALIGN_LEFT, 0, 12, 6, bitmap);
+	assert(bitmap[0] == 0xa0);
+	assert(bitmap[1] == 0xa0);
+	assert(bitmap[6] == 0xa0);
+	assert(bitmap[7] == 0x00);
+
+	// explicit line break with negative line spacing
+	monobus_font_render(&font, "A\nA", ALIGN_LEFT, -1, 12, 5, bitmap);
+	assert(bitmap[0] == 0xa0);
+	assert(bitmap[2] == 0x40);
+	assert(bitmap[4] == 0xe0); // overlapping rows of both lines
+	assert(bitmap[6] == 0x40);
+	assert(bitmap[8] == 0xe0);
+
+	monobus_font_free(&font);
+
+	// BDF with oversized glyph, whose bitmap length would wrap in 32-bit
+	static const char bdf_huge [] =
+		"STARTFONT 2.1\n"
+		"STARTCHAR A\n"
+		"ENCODING 65\n"
+		"DWIDTH 4 0\n"
+		"BBX 2147483647 65552 0 0\n"
+		"BITMAP\n"
+		"FF\n"
+		"ENDCHAR\n"
+		"ENDFONT\n";
+
+	assert(monobus_font_load(&font, (const uint8_t *)bdf_huge,
+		sizeof(bdf_huge) - 1) == -1);
+}
+
 int
 main(int argc __attribute__((unused)), char **argv __attribute__((unused)))
 {
 	(void)lv2_osc_hooks; //FIXME
 	_test_parse();
 	_test_crc8();
+	_test_unframer();
+	_test_termios_speed();
+	_test_timetag_ns();
 	_test_stride();
+	_test_bin();
+	_test_pbm();
+	_test_pnm();
+	_test_scale();
+	_test_dither();
+	_test_font();
 
 	return 0;
 }
@@ -15,22 +15,39 @@
  * http://www.perlfoundation.org/artistic_license_2_0.
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
 #include <syslog.h>
+#include <time.h>
+#include <fcntl.h>
 
-#if defined(HAVE_NETPBM_SUBDIR)
-#	include <netpbm/pbm.h>
-#else
-#	include <pbm.h>
+#if defined(HAVE_ZLIB)
+#	include <zlib.h>
 #endif
 
-#include <osc.lv2/writer.h>
-#include <osc.lv2/stream.h>
-
-#include <varchunk.h>
 #include <monobus.h>
+#include <monobus_client.h>
 
+#define NSECS 1000000000
+#define JAN_1970 2208988800ULL
+#define LAYER_MAX 32
+
+typedef struct _layer_t layer_t;
 typedef struct _app_t app_t;
 
+struct _layer_t {
+	uint8_t prio;
+	int32_t xoff;
+	int32_t yoff;
+	const char *path;
+	const char *text;
+	bool clr;
+};
+
 struct _app_t {
 	int32_t xoff;
 	int32_t yoff;
@@ -38,98 +55,757 @@ struct _app_t {
 	const char *url;
 	const char *path;
 	bool clr;
+	bool bin;
+	bool streaming;
+	double fps;
+	unsigned width;
+	unsigned height;
+	dither_t dither;
+
+	uint8_t *scratch; // dither error, luminance, scaled and intermediate buffers
+	size_t scratch_len;
 
-	LV2_OSC_Stream stream;
+	const char *font_path;
+	const char *text;
+	align_t align;
+	int spacing;
+	font_t font;
 
+	bool scheduled; // send frames ahead of time in timetagged bundles
+	double delay; // of first scheduled frame relative to now
+	size_t mtu;
+	uint64_t start; // timetag of first scheduled frame
+	uint64_t frames; // number of scheduled frames
+
+	bool diff; // send bounding rectangle of changed pixels only
+	unsigned keyframe; // interval of frames sent in full while diffing
+	struct {
+		int32_t width;
+		int32_t height;
+	} staged;
 	struct {
-		varchunk_t *rx;
-		varchunk_t *tx;
-	} rb;
+		bool valid;
+		uint8_t prio;
+		int32_t xoff;
+		int32_t yoff;
+		int32_t width;
+		int32_t height;
+		unsigned frames; // since last keyframe
+		size_t len;
+		uint8_t *bitmap; // last frame sent
+		uint8_t *staged; // frame to be compared with last one
+	} last;
+
+	unsigned nlayers;
+	layer_t layers [LAYER_MAX];
+
+	monobus_client_t *client;
 };
 
-static void *
-_write_req(void *data, size_t minimum, size_t *maximum)
+static uint64_t
+_timetag(app_t *app)
 {
-	app_t *app = data;
+	if(app->fps <= 0.0)
+	{
+		return app->start;
+	}
 
-	return varchunk_write_request_max(app->rb.rx, minimum, maximum);
+	return app->start + (uint64_t)(app->frames / app->fps * 0x1p32);
 }
 
-static void
-_write_adv(void *data, size_t written)
+static uint8_t *
+_update_reserve(app_t *app, int32_t x, int32_t y, int32_t width,
+	int32_t height)
 {
-	app_t *app = data;
+	if(app->scheduled)
+	{
+		monobus_client_set_timetag(app->client, _timetag(app));
+	}
 
-	varchunk_write_advance(app->rb.rx, written);
+	return monobus_client_layer_begin(app->client, app->prio, x, y,
+		width, height);
 }
 
-static const void *
-_read_req(void *data, size_t *toread)
+static int
+_update_commit(app_t *app)
 {
-	app_t *app = data;
+	if(app->scheduled)
+	{
+		app->frames++;
+	}
 
-	return varchunk_read_request(app->rb.tx, toread);
+	return monobus_client_layer_end(app->client);
 }
 
-static void
-_read_adv(void *data)
+static uint8_t *
+_update_begin(app_t *app, int32_t width, int32_t height, size_t len)
 {
-	app_t *app = data;
+	if(!app->diff)
+	{
+		return _update_reserve(app, app->xoff, app->yoff, width, height);
+	}
+
+	// stage frame to compare it with the last one sent
+	if(len > app->last.len)
+	{
+		uint8_t *staged = realloc(app->last.staged, len);
+		if(!staged)
+		{
+			syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+			return NULL;
+		}
+
+		app->last.staged = staged;
+
+		uint8_t *bitmap = realloc(app->last.bitmap, len);
+		if(!bitmap)
+		{
+			syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+			return NULL;
+		}
+
+		app->last.bitmap = bitmap;
+		app->last.len = len;
+	}
 
-	varchunk_read_advance(app->rb.tx);
+	app->staged.width = width;
+	app->staged.height = height;
+
+	return app->last.staged;
 }
 
-static const LV2_OSC_Driver driver = {
-	.write_req = _write_req,
-	.write_adv = _write_adv,
-	.read_req = _read_req,
-	.read_adv = _read_adv
-};
+static int
+_update_rect(app_t *app, const uint8_t *bitmap, int32_t width, int32_t x0,
+	int32_t y0, int32_t w, int32_t h)
+{
+	const unsigned stride = monobus_stride_for_width(width);
+	const unsigned dst_stride = monobus_stride_for_width(w);
+	uint8_t *body = _update_reserve(app, app->xoff + x0, app->yoff + y0, w, h);
+	if(!body)
+	{
+		return -1;
+	}
 
-static void
-_osc_deinit(app_t *app)
+	// shift rectangle to byte boundary of its left edge
+	const unsigned b0 = x0 / 8;
+	const unsigned shift = x0 % 8;
+	const uint8_t tail = (w % 8) ? 0xff << (8 - w % 8) : 0xff;
+
+	for(int32_t y = 0; y < h; y++)
+	{
+		const uint8_t *src = &bitmap[(y0 + y) * stride];
+		uint8_t *dst = &body[y * dst_stride];
+
+		for(unsigned k = 0; k < dst_stride; k++)
+		{
+			const uint8_t hi = src[b0 + k];
+			const uint8_t lo = (b0 + k + 1 < stride) ? src[b0 + k + 1] : 0x0;
+
+			dst[k] = shift ? (hi << shift) | (lo >> (8 - shift)) : hi;
+		}
+
+		dst[dst_stride - 1] &= tail;
+	}
+
+	return _update_commit(app);
+}
+
+static int
+_update_end(app_t *app)
 {
-	lv2_osc_stream_deinit(&app->stream);
+	if(!app->diff)
+	{
+		return _update_commit(app);
+	}
+
+	const int32_t width = app->staged.width;
+	const int32_t height = app->staged.height;
+	const unsigned stride = monobus_stride_for_width(width);
+	uint8_t *staged = app->last.staged;
+
+	const bool keyframe = !app->last.valid
+		|| (app->last.prio != app->prio)
+		|| (app->last.xoff != app->xoff)
+		|| (app->last.yoff != app->yoff)
+		|| (app->last.width != width)
+		|| (app->last.height != height)
+		|| (app->keyframe && (app->last.frames >= app->keyframe) );
 
-	if(app->rb.rx)
+	// find bounding rectangle of changed pixels
+	int32_t x0 = width;
+	int32_t x1 = -1;
+	int32_t y0 = height;
+	int32_t y1 = -1;
+
+	if(keyframe)
 	{
-		varchunk_free(app->rb.rx);
+		x0 = 0;
+		x1 = width - 1;
+		y0 = 0;
+		y1 = height - 1;
+		app->last.frames = 0;
 	}
+	else
+	{
+		const uint8_t tail = (width % 8) ? 0xff << (8 - width % 8) : 0xff;
+
+		for(int32_t y = 0; y < height; y++)
+		{
+			const uint8_t *cur = &staged[y * stride];
+			const uint8_t *old = &app->last.bitmap[y * stride];
+
+			for(unsigned k = 0; k < stride; k++)
+			{
+				uint8_t delta = cur[k] ^ old[k];
 
-	if(app->rb.tx)
+				if(k == stride - 1)
+				{
+					delta &= tail; // ignore row padding
+				}
+
+				if(!delta)
+				{
+					continue;
+				}
+
+				int32_t first = k*8;
+				int32_t last = k*8 + 7;
+
+				for(uint8_t mask = 0x80; !(delta & mask); mask >>= 1)
+				{
+					first++;
+				}
+
+				for(uint8_t mask = 0x01; !(delta & mask); mask <<= 1)
+				{
+					last--;
+				}
+
+				if(first < x0)
+				{
+					x0 = first;
+				}
+
+				if(last > x1)
+				{
+					x1 = last;
+				}
+
+				if(y < y0)
+				{
+					y0 = y;
+				}
+
+				y1 = y;
+			}
+		}
+
+		app->last.frames++;
+	}
+
+	// swap staged and last bitmap
+	app->last.staged = app->last.bitmap;
+	app->last.bitmap = staged;
+	app->last.valid = true;
+	app->last.prio = app->prio;
+	app->last.xoff = app->xoff;
+	app->last.yoff = app->yoff;
+	app->last.width = width;
+	app->last.height = height;
+
+	if( (y1 < y0) || (x1 < x0) ) // nothing changed
 	{
-		varchunk_free(app->rb.tx);
+		if(app->scheduled)
+		{
+			app->frames++; // keep timetags of following frames
+		}
+
+		return 0;
 	}
+
+	return _update_rect(app, staged, width, x0, y0, x1 - x0 + 1, y1 - y0 + 1);
 }
 
 static int
-_osc_init(app_t *app)
+_write_clear(app_t *app)
 {
-	app->rb.rx = varchunk_new(8192, true);
-	if(!app->rb.rx)
+	if(app->scheduled)
 	{
-		goto failure;
+		monobus_client_set_timetag(app->client, _timetag(app));
 	}
 
-	app->rb.tx = varchunk_new(8192, true);
-	if(!app->rb.tx)
+	return monobus_client_clear_layer(app->client, app->prio);
+}
+
+static int
+_read_pbm(pbm_reader_t *reader, pbm_image_t *image)
+{
+	const int ret = monobus_pbm_next(reader, image);
+
+	if(ret == -1)
 	{
-		goto failure;
+		syslog(LOG_ERR, "[%s] 'invalid PNM header'", __func__);
 	}
 
-	if(lv2_osc_stream_init(&app->stream, app->url, &driver, app) != 0)
+	return ret;
+}
+
+static int
+_write_pnm(app_t *app, pbm_reader_t *reader, const pbm_image_t *image)
+{
+	if(  (image->width == 0) || (image->height == 0)
+		|| (app->width == 0) || (app->height == 0) )
+	{
+		syslog(LOG_ERR, "[%s] 'invalid image dimensions'", __func__);
+		return -1;
+	}
+
+	const size_t err_len = MONOBUS_DITHER_ERR_LEN(app->width) * sizeof(int16_t);
+	const size_t scaled_len = app->width * app->height;
+	const size_t tmp_len = app->width * image->height;
+	const size_t len = err_len + image->len + scaled_len + tmp_len;
+
+	// grow scratch buffer only, as streamed images mostly share dimensions
+	if(len > app->scratch_len)
+	{
+		uint8_t *scratch = realloc(app->scratch, len);
+		if(!scratch)
+		{
+			syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+			return -1;
+		}
+
+		app->scratch = scratch;
+		app->scratch_len = len;
+	}
+
+	int16_t *err = (int16_t *)app->scratch; // first for alignment
+	uint8_t *gray = app->scratch + err_len;
+	uint8_t *scaled = gray + image->len;
+	uint8_t *tmp = scaled + scaled_len;
+
+	if(monobus_pbm_decode_gray(reader, image, gray) != 0)
+	{
+		syslog(LOG_ERR, "[%s] 'invalid PNM raster'", __func__);
+		return -1;
+	}
+
+	monobus_gray_scale(gray, image->width, image->height,
+		scaled, app->width, app->height, tmp);
+
+	// dither scaled image straight into the reserved blob
+	uint8_t *body = _update_begin(app, app->width, app->height,
+		monobus_stride_for_width(app->width) * app->height);
+	if(!body)
+	{
+		return -1;
+	}
+
+	monobus_gray_dither(scaled, app->width, app->height, app->dither, err, body);
+
+	return _update_end(app);
+}
+
+static int
+_write_pbm(app_t *app, pbm_reader_t *reader, const pbm_image_t *image)
+{
+	if(image->channels != 0)
+	{
+		return _write_pnm(app, reader, image);
+	}
+
+	// decode image straight into the reserved blob
+	uint8_t *body = _update_begin(app, image->width, image->height, image->len);
+	if(!body)
+	{
+		return -1;
+	}
+
+	if(monobus_pbm_decode(reader, image, body) != 0)
+	{
+		syslog(LOG_ERR, "[%s] 'invalid PBM raster'", __func__);
+		return -1;
+	}
+
+	return _update_end(app);
+}
+
+static int
+_font_init(app_t *app)
+{
+	uint8_t *buf = NULL;
+	size_t len = 0;
+	size_t maxlen = 0;
+
+	// fonts are loaded once, optionally gzip compressed like in X11 font dirs
+#if defined(HAVE_ZLIB)
+	gzFile file = gzopen(app->font_path, "rb");
+	if(!file)
+#else
+	const int fd = open(app->font_path, O_RDONLY);
+	if(fd == -1)
+#endif
 	{
 		syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+		return -1;
+	}
+
+	while(true)
+	{
+		if(len == maxlen)
+		{
+			maxlen = maxlen ? maxlen * 2 : 0x10000;
+
+			uint8_t *tmp = realloc(buf, maxlen);
+			if(!tmp)
+			{
+				syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+				goto failure;
+			}
+
+			buf = tmp;
+		}
+
+#if defined(HAVE_ZLIB)
+		const int n = gzread(file, &buf[len], maxlen - len);
+#else
+		const ssize_t n = read(fd, &buf[len], maxlen - len);
+#endif
+
+		if(n < 0)
+		{
+			syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+			goto failure;
+		}
+		else if(n == 0)
+		{
+			break; // end of file
+		}
+
+		len += n;
+	}
+
+	if(monobus_font_load(&app->font, buf, len) != 0)
+	{
+		syslog(LOG_ERR, "[%s] 'invalid BDF or PCF font'", __func__);
 		goto failure;
 	}
 
+	free(buf);
+#if defined(HAVE_ZLIB)
+	gzclose(file);
+#else
+	close(fd);
+#endif
 	return 0;
 
 failure:
-	_osc_deinit(app);
+	free(buf);
+#if defined(HAVE_ZLIB)
+	gzclose(file);
+#else
+	close(fd);
+#endif
 	return -1;
 }
 
+static int
+_write_text(app_t *app, const char *text)
+{
+	if(app->font.nglyphs == 0)
+	{
+		syslog(LOG_ERR, "[%s] 'no font given'", __func__);
+		return -1;
+	}
+
+	// render text straight into the reserved blob
+	uint8_t *body = _update_begin(app, app->width, app->height,
+		monobus_stride_for_width(app->width) * app->height);
+	if(!body)
+	{
+		return -1;
+	}
+
+	monobus_font_render(&app->font, text, app->align, app->spacing,
+		app->width, app->height, body);
+
+	return _update_end(app);
+}
+
+static int
+_flush(app_t *app)
+{
+	return monobus_client_flush(app->client);
+}
+
+static void
+_pace(app_t *app, struct timespec *to)
+{
+	if(app->fps <= 0.0)
+	{
+		return;
+	}
+
+	// sleep until next frame timestamp
+	to->tv_nsec += NSECS / app->fps;
+	while(to->tv_nsec >= NSECS)
+	{
+		to->tv_sec += 1;
+		to->tv_nsec -= NSECS;
+	}
+
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, to, NULL) == EINTR)
+	{
+		// retry
+	}
+}
+
+static int
+_next_frame(app_t *app, struct timespec *to)
+{
+	if(app->scheduled)
+	{
+		return 0; // frames leave in a burst, played back by timetag
+	}
+
+	if(_flush(app) != 0)
+	{
+		return -1;
+	}
+
+	_pace(app, to);
+
+	return 0;
+}
+
+static int
+_stream_pbm(app_t *app, pbm_reader_t *reader)
+{
+	struct timespec to;
+	clock_gettime(CLOCK_MONOTONIC, &to);
+
+	while(true)
+	{
+		pbm_image_t image;
+
+		switch(_read_pbm(reader, &image))
+		{
+			case 0:
+			{
+				// end of file
+			}	return 0;
+			case 1:
+			{
+				// next image
+			}	break;
+			default:
+			{
+				// invalid image
+			}	return -1;
+		}
+
+		if( (_write_pbm(app, reader, &image) != 0) || (_next_frame(app, &to) != 0) )
+		{
+			return -1;
+		}
+	}
+}
+
+static int
+_read_text(app_t *app, int fd)
+{
+	FILE *file = fdopen(dup(fd), "r");
+	if(!file)
+	{
+		syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+		return -1;
+	}
+
+	struct timespec to;
+	clock_gettime(CLOCK_MONOTONIC, &to);
+
+	char *line = NULL;
+	size_t maxlen = 0;
+	ssize_t len;
+	int ret = 0;
+
+	// in stream mode every line is an update, else the whole input is one
+	while( (len = getdelim(&line, &maxlen, app->streaming ? '\n' : '\0', file)) != -1)
+	{
+		while( (len > 0) && (line[len - 1] == '\n') )
+		{
+			line[--len] = '\0';
+		}
+
+		if( (_write_text(app, line) != 0) || (_next_frame(app, &to) != 0) )
+		{
+			ret = -1;
+			break;
+		}
+
+		if(!app->streaming)
+		{
+			break;
+		}
+	}
+
+	free(line);
+	fclose(file);
+
+	return ret;
+}
+
+static int
+_single_pbm(app_t *app, pbm_reader_t *reader)
+{
+	pbm_image_t image;
+
+	switch(_read_pbm(reader, &image))
+	{
+		case 0:
+		{
+			syslog(LOG_ERR, "[%s] 'unexpected end of file'", __func__);
+		}	return -1;
+		case 1:
+		{
+			// success
+		}	break;
+		default:
+		{
+			// invalid image
+		}	return -1;
+	}
+
+	return _write_pbm(app, reader, &image);
+}
+
+static const char *dithers [] = {
+	[DITHER_THRESHOLD] = "threshold",
+	[DITHER_BAYER]     = "bayer",
+	[DITHER_FLOYD]     = "floyd"
+};
+
+static const char *aligns [] = {
+	[ALIGN_LEFT]       = "left",
+	[ALIGN_CENTER]     = "center",
+	[ALIGN_RIGHT]      = "right"
+};
+
+static int
+_write_input(app_t *app)
+{
+	const int fd = strcmp(app->path, "-")
+		? open(app->path, O_RDONLY)
+		: STDIN_FILENO;
+
+	if(fd == -1)
+	{
+		syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+		return -1;
+	}
+
+	int ret;
+
+	if(app->font_path)
+	{
+		ret = _read_text(app, fd);
+	}
+	else
+	{
+		pbm_reader_t reader;
+		ret = monobus_pbm_init(&reader, fd);
+
+		if(ret == 0)
+		{
+			ret = app->streaming
+				? _stream_pbm(app, &reader)
+				: _single_pbm(app, &reader);
+		}
+
+		monobus_pbm_deinit(&reader);
+	}
+
+	if(fd != STDIN_FILENO)
+	{
+		close(fd);
+	}
+
+	return ret;
+}
+
+static int
+_write_layer(app_t *app)
+{
+	if(app->clr)
+	{
+		return _write_clear(app);
+	}
+	else if(app->text)
+	{
+		return _write_text(app, app->text);
+	}
+
+	return _write_input(app);
+}
+
+static int
+_layer_push(app_t *app)
+{
+	if(app->nlayers == LAYER_MAX)
+	{
+		fprintf(stderr, "Too many layers, maximum is %u.\n", LAYER_MAX);
+		return -1;
+	}
+
+	layer_t *layer = &app->layers[app->nlayers++];
+
+	layer->prio = app->prio;
+	layer->xoff = app->xoff;
+	layer->yoff = app->yoff;
+	layer->path = app->path;
+	layer->text = app->text;
+	layer->clr = app->clr;
+
+	// priority and offsets carry over to next layer
+	app->path = "-";
+	app->text = NULL;
+	app->clr = false;
+
+	return 0;
+}
+
+static int
+_write_layers(app_t *app)
+{
+	// all layers go into one bundle to be applied within the same beat
+	if(monobus_client_bundle_begin(app->client,
+		app->scheduled ? app->start : MONOBUS_CLIENT_IMMEDIATE) != 0)
+	{
+		syslog(LOG_ERR, "[%s] 'bundles unavailable'", __func__);
+		return -1;
+	}
+
+	for(unsigned i = 0; i < app->nlayers; i++)
+	{
+		const layer_t *layer = &app->layers[i];
+
+		app->prio = layer->prio;
+		app->xoff = layer->xoff;
+		app->yoff = layer->yoff;
+		app->path = layer->path;
+		app->text = layer->text;
+		app->clr = layer->clr;
+
+		if(_write_layer(app) != 0)
+		{
+			monobus_client_bundle_abort(app->client); // discard whole bundle
+			return -1;
+		}
+	}
+
+	return monobus_client_bundle_commit(app->client);
+}
+
 static void
 _version(void)
 {
@@ -155,25 +831,41 @@ _usage(char **argv, app_t *app)
 	fprintf(stderr,
 		"--------------------------------------------------------------------\n"
 		"USAGE\n"
-		"   %s [OPTIONS] FILE.PBM|-\n"
+		"   %s [OPTIONS]\n"
 		"\n"
 		"OPTIONS\n"
 		"   [-v]                     print version information\n"
 		"   [-h]                     print usage information\n"
 		"   [-d]                     enable verbose logging\n"
 		"   [-P] PRIO                set priority of message (%"PRIu8")\n"
-		"   [-X] X_OFSET             set x-offset of bitmap (%"PRIu8")\n"
-		"   [-Y] Y_OFSET             set y-offset of bitmap (%"PRIu8")\n"
+		"   [-X] X_OFSET             set x-offset of bitmap (%"PRIi32")\n"
+		"   [-Y] Y_OFSET             set y-offset of bitmap (%"PRIi32")\n"
 		"   [-U] URI                 OSC URI (%s)\n"
-		"   [-I] FILE                Bitmap in PBM format (%s)\n"
+		"   [-I] FILE                Image in PBM, PGM or PPM format (%s)\n"
 		"   [-C]                     clear whole bitmap with given priority\n"
-		, argv[0], app->xoff, app->yoff, app->prio, app->url, app->path);
+		"   [-R]                     use native binary protocol instead of OSC\n"
+		"   [-S]                     stream all concatenated bitmaps from FILE\n"
+		"   [-F] FPS                 pace streamed bitmaps at frame rate (%.1f)\n"
+		"   [-W] WIDTH               scale PGM/PPM images to width (%u)\n"
+		"   [-H] HEIGHT              scale PGM/PPM images to height (%u)\n"
+		"   [-D] DITHER              dither PGM/PPM images with threshold|bayer|floyd (%s)\n"
+		"   [-f] FONT                render text from FILE with BDF or PCF font\n"
+		"   [-T] TEXT                render given text instead of reading FILE\n"
+		"   [-A] ALIGN               align text with left|center|right (%s)\n"
+		"   [-L] SPACING             additional line spacing of text (%i)\n"
+		"   [-B] DELAY               pre-schedule frames in timetagged bundles from now+DELAY\n"
+		"   [-M] MTU                 maximal packet size of pre-scheduled frames (%zu)\n"
+		"   [-N]                     add layer to bundle and start next one\n"
+		"   [-Z]                     send changed rectangle of streamed frames only\n"
+		"   [-K] FRAMES              send every n-th streamed frame in full (%u)\n"
+		, argv[0], app->prio, app->xoff, app->yoff, app->url, app->path, app->fps,
+		app->width, app->height, dithers[app->dither], aligns[app->align],
+		app->spacing, app->mtu, app->keyframe);
 }
 
 int
 main(int argc, char **argv)
 {
-	(void)lv2_osc_stream_pollin; //FIXME
 	(void)lv2_osc_hooks; //FIXME
 	static app_t app;
 	int logp = LOG_INFO;
@@ -183,11 +875,14 @@ main(int argc, char **argv)
 	app.prio = 0;
 	app.url = "osc.udp://localhost:7777";
 	app.path = "-";
-
-	int width = 0;
-	int height = 0;
-	int format = 0;
-	FILE *fin = stdin;
+	app.fps = 0.0;
+	app.width = WIDTH_NET;
+	app.height = HEIGHT_NET;
+	app.dither = DITHER_FLOYD;
+	app.align = ALIGN_CENTER;
+	app.spacing = 0;
+	app.mtu = MONOBUS_CLIENT_MTU;
+	app.keyframe = 0;
 
 	fprintf(stderr,
 		"%s "MONOBUS_VERSION"\n"
@@ -196,7 +891,7 @@ main(int argc, char **argv)
 		argv[0]);
 
 	int c;
-	while( (c = getopt(argc, argv, "vhdP:X:Y:U:I:C") ) != -1)
+	while( (c = getopt(argc, argv, "vhdP:X:Y:U:I:CRSF:W:H:D:f:T:A:L:B:M:NZK:") ) != -1)
 	{
 		switch(c)
 		{
@@ -236,10 +931,110 @@ main(int argc, char **argv)
 			{
 				app.clr = true;
 			} break;
+			case 'R':
+			{
+				app.bin = true;
+			} break;
+			case 'S':
+			{
+				app.streaming = true;
+			} break;
+			case 'F':
+			{
+				app.fps = atof(optarg);
+			} break;
+			case 'W':
+			{
+				app.width = atoi(optarg);
+			} break;
+			case 'H':
+			{
+				app.height = atoi(optarg);
+			} break;
+			case 'D':
+			{
+				if(!strcmp(optarg, dithers[DITHER_THRESHOLD]))
+				{
+					app.dither = DITHER_THRESHOLD;
+				}
+				else if(!strcmp(optarg, dithers[DITHER_BAYER]))
+				{
+					app.dither = DITHER_BAYER;
+				}
+				else if(!strcmp(optarg, dithers[DITHER_FLOYD]))
+				{
+					app.dither = DITHER_FLOYD;
+				}
+				else
+				{
+					fprintf(stderr, "Unknown dithering `%s'.\n", optarg);
+					return -1;
+				}
+			} break;
+			case 'f':
+			{
+				app.font_path = optarg;
+			} break;
+			case 'T':
+			{
+				app.text = optarg;
+			} break;
+			case 'A':
+			{
+				if(!strcmp(optarg, aligns[ALIGN_LEFT]))
+				{
+					app.align = ALIGN_LEFT;
+				}
+				else if(!strcmp(optarg, aligns[ALIGN_CENTER]))
+				{
+					app.align = ALIGN_CENTER;
+				}
+				else if(!strcmp(optarg, aligns[ALIGN_RIGHT]))
+				{
+					app.align = ALIGN_RIGHT;
+				}
+				else
+				{
+					fprintf(stderr, "Unknown alignment `%s'.\n", optarg);
+					return -1;
+				}
+			} break;
+			case 'L':
+			{
+				app.spacing = atoi(optarg);
+			} break;
+			case 'B':
+			{
+				app.scheduled = true;
+				app.delay = atof(optarg);
+			} break;
+			case 'M':
+			{
+				app.mtu = atoi(optarg);
+			} break;
+			case 'N':
+			{
+				if(_layer_push(&app) != 0)
+				{
+					return -1;
+				}
+			} break;
+			case 'Z':
+			{
+				app.diff = true;
+			} break;
+			case 'K':
+			{
+				app.keyframe = atoi(optarg);
+			} break;
 
 			case '?':
 			{
-				if( (optopt == 'U') || (optopt == 'I') )
+				if( (optopt == 'U') || (optopt == 'I') || (optopt == 'F')
+					|| (optopt == 'W') || (optopt == 'H') || (optopt == 'D')
+					|| (optopt == 'f') || (optopt == 'T') || (optopt == 'A')
+					|| (optopt == 'L') || (optopt == 'B') || (optopt == 'M')
+					|| (optopt == 'K') )
 				{
 					fprintf(stderr, "Option `-%c' requires an argument.\n", optopt);
 				}
@@ -262,95 +1057,86 @@ main(int argc, char **argv)
 	openlog(NULL, LOG_PERROR, LOG_DAEMON);
 	setlogmask(LOG_UPTO(logp));
 
-	if(_osc_init(&app) == -1)
+	if(app.nlayers > 0)
 	{
-		return -1;
+		if(_layer_push(&app) != 0)
+		{
+			return -1;
+		}
+
+		if(app.streaming || app.bin)
+		{
+			fprintf(stderr, "Option `-N' cannot be combined with `-S' or `-R'.\n");
+			return -1;
+		}
+
+		app.diff = false; // layers are sent once anyway
 	}
 
-	size_t sz = 0;
-	uint8_t *buf = varchunk_write_request_max(app.rb.tx, 1024, &sz);
-	if(!buf)
+	if(app.text && !app.font_path)
 	{
-		syslog(LOG_ERR, "varchunk_write_request_max");
-		goto failure;
+		fprintf(stderr, "Option `-T' requires a font given with `-f'.\n");
+		return -1;
 	}
 
-	LV2_OSC_Writer writer;
-	size_t written;
-
-	lv2_osc_writer_initialize(&writer, buf, sz);
-
-	char path [32];
-	snprintf(path, sizeof(path), "/monobus/%"PRIu8, app.prio);
-
-	if(app.clr)
+	if(app.scheduled && app.streaming && (app.fps <= 0.0) )
 	{
-		if(!lv2_osc_writer_message_vararg(&writer, path, ""))
-		{
-			syslog(LOG_ERR, "lv2_osc_writer_message_vararg");
-			goto failure;
-		}
+		fprintf(stderr, "Option `-B' requires a frame rate given with `-F'.\n");
+		return -1;
 	}
-	else
-	{
-		if(strcmp(app.path, "-"))
-		{
-			fin = fopen(app.path, "rb");
-		}
 
-		if(!fin)
-		{
-			syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
-			return -1;
-		}
+	if(app.scheduled)
+	{
+		struct timespec now;
+		clock_gettime(CLOCK_REALTIME, &now);
 
-		pbm_init(&argc, argv);
-		pbm_readpbminit(fin, &width, &height, &format);
+		const double start = now.tv_sec + now.tv_nsec * 1e-9 + app.delay;
 
-		const unsigned stride = monobus_stride_for_width(width);
-		const unsigned len = stride * height;
-		uint8_t *bitmap = alloca(len);
-		if(!bitmap)
-		{
-			syslog(LOG_ERR, "[%s] 'out of memory'", __func__);
-			fclose(fin);
-			return -1;
-		}
+		app.start = (uint64_t)((start + JAN_1970) * 0x1p32);
+	}
 
-		memset(bitmap, 0x0, len);
-		pbm_readpbmrow_packed(fin, bitmap, width*height, format);
+	app.client = monobus_client_new(app.url, app.bin);
+	if(!app.client)
+	{
+		return -1;
+	}
 
-		if(fin != stdin)
-		{
-			fclose(fin);
-		}
+	monobus_client_set_mtu(app.client, app.mtu);
 
+	if(app.font_path && (_font_init(&app) != 0) )
+	{
+		goto failure;
+	}
 
-		if(!lv2_osc_writer_message_vararg(&writer, path, "iiiib",
-			app.xoff, app.yoff, (int32_t)width, (int32_t)height, len, bitmap))
+	if(app.nlayers > 0)
+	{
+		if(_write_layers(&app) != 0)
 		{
-			syslog(LOG_ERR, "lv2_osc_writer_message_vararg");
 			goto failure;
 		}
 	}
-
-	if(!lv2_osc_writer_finalize(&writer, &written))
+	else if(_write_layer(&app) != 0)
 	{
-		syslog(LOG_ERR, "lv2_osc_writer_finalize");
 		goto failure;
 	}
 
-	varchunk_write_advance(app.rb.tx, written);
-
-	while( (lv2_osc_stream_run(&app.stream) & LV2_OSC_SEND) != LV2_OSC_SEND)
+	if(_flush(&app) != 0)
 	{
-		usleep(1000);
+		goto failure;
 	}
 
-	_osc_deinit(&app);
+	monobus_font_free(&app.font);
+	free(app.last.bitmap);
+	free(app.last.staged);
+	free(app.scratch);
+	monobus_client_free(app.client);
 	return 0;
 
 failure:
-		_osc_deinit(&app);
+		monobus_font_free(&app.font);
+		free(app.last.bitmap);
+		free(app.last.staged);
+		free(app.scratch);
+		monobus_client_free(app.client);
 		return -1;
 }
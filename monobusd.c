@@ -22,9 +22,16 @@
 #include <time.h>
 #include <signal.h>
 #include <pthread.h>
+#include <semaphore.h>
 #include <stdatomic.h>
 #include <ncurses.h>
 #include <locale.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 
 #ifdef HAVE_LIBFTDI1
 #	include <libftdi1/ftdi.h>
@@ -40,44 +47,230 @@
 #define FTDI_VID   0x0403
 #define FT232_PID  0x6001
 #define NSECS      1000000000
-#define JAN_1970   2208988800ULL
-
+#define RB_SIZE    8192
+#define RB_MIN     (LV2_OSC_STREAM_REQBUF * 4) // largest request fits when wrapped
+#define RB_MAX     0x40000000 // 1 G
+#define TX_SIZE    8192 // of tx ringbuffer, monobusd never replies
+#define HUGE_SIZE  0x200000 // 2 M
+#define EVICT_MAX  1024
+#define EVICT_DIRTY 0x4
+#define SHARD_MAX  64
+#define XMIT_MAX   1024 // framed messages of one beat
+#define XMIT_SIZE  (XMIT_MAX * 2) // ready-to-send beats
+#define REPLY_NS   100000000 // time given to slave to reply (half-duplex)
+#define SLAVE_ID   0x2
+#define BAUD_RATE  19200 // of MonoBus
+#define PROBE_TRIES 3 // STATUS round trips needed per line rate
+#define CALIBRATE_TRIES 8 // STATUS round trips averaged per latency timer
+#define CLOCK_TRIES 3 // clock readings per beat, tightest one is kept
+#define CLOCK_STEP_NS 1000000 // offset change logged as wall-clock step
+#define DEGRADE_MAX 8 // maximal frame rate divisor when degrading
+#define DEGRADE_RECOVER 16 // punctual frames before frame rate is raised again
+#define MUL        2 // terminal cells per simulated pixel
+#define SIM_UNSET  0x2 // simulated pixel not drawn yet
+
+typedef enum _transport_t {
+	TRANSPORT_FTDI = 0,
+	TRANSPORT_TTY,
+	TRANSPORT_FILE
+} transport_t;
+
+typedef enum _policy_t {
+	POLICY_BLOCK = 0,
+	POLICY_DROP,
+	POLICY_EVICT
+} policy_t;
+
+typedef enum _overrun_t {
+	OVERRUN_SKIP = 0,
+	OVERRUN_DROP,
+	OVERRUN_DEGRADE
+} overrun_t;
+
+typedef struct _serial_driver_t serial_driver_t;
 typedef struct _sched_t sched_t;
+typedef struct _evict_t evict_t;
+typedef struct _shard_t shard_t;
 typedef struct _app_t app_t;
 
+struct _serial_driver_t {
+	int (*init)(app_t *app);
+	int (*xmit)(app_t *app, const uint8_t *buf, ssize_t sz);
+	int (*drain)(app_t *app); // wait for asynchronous write to complete
+	void (*deinit)(app_t *app);
+	ssize_t (*recv)(app_t *app, uint8_t *buf, size_t len, int timeout_ms);
+	int (*set_baud)(app_t *app, uint32_t baud);
+	int (*set_latency)(app_t *app, uint8_t latency);
+	bool half_duplex; // wait for slave to reply after each message
+};
+
 struct _sched_t {
 	sched_t *next;
-	struct timespec to;
+	int64_t to; // deadline on monotonic clock in ns
+	bool bin;
 	size_t len;
 	uint8_t buf [];
 };
 
+// triple buffer holding the latest overflowed update per priority level
+struct _evict_t {
+	atomic_uint middle; // index of middle buffer | EVICT_DIRTY
+	unsigned back; // producer-owned
+	unsigned front; // consumer-owned
+	size_t len [3];
+	uint8_t buf [3][EVICT_MAX];
+};
+
+// ingestion thread with its own socket bound to the shared server port
+struct _shard_t {
+	app_t *app;
+	unsigned idx;
+	bool bin; // native binary protocol instead of OSC
+
+	LV2_OSC_Stream stream;
+	pthread_t thread;
+
+	struct {
+		varchunk_t *rx;
+		varchunk_t *tx;
+		size_t rx_map; // mapped length when backed by huge pages
+	} rb;
+
+	struct {
+		atomic_uint_fast64_t blocked;
+		atomic_uint_fast64_t dropped;
+		atomic_uint_fast64_t evicted;
+	} stats;
+
+	bool blocked;
+	bool scratched;
+	uint8_t scratch [0x10000];
+	evict_t evict [32];
+	atomic_uint_fast64_t overflow; // evictions since ring was last in order
+};
+
 struct _app_t {
+	const char *serial_url;
+	transport_t transport;
+	const char *path; // of tty or file
+	uint32_t baud;
+	bool probe; // for fastest line rate
+	uint8_t latency; // timer of FTDI adapter in ms, 0 for chip default
+	bool calibrate; // for lowest-latency timer
+	unsigned chunksize; // of FTDI USB transfers, 0 for library default
 	uint16_t vid;
 	uint16_t pid;
 	const char *sid;
 	const char *des;
 	uint32_t fps;
+	overrun_t overrun;
 	const char *url;
 	bool simulate;
-
-	LV2_OSC_Stream stream;
+	uint32_t redraw; // maximal redraw rate of simulation
+	const char *record;
+	FILE *rec;
+	size_t rb_size;
+	bool huge;
+	policy_t policy;
+	unsigned nshards;
+	const char *bin_url;
+	unsigned nrings; // OSC shards plus optional binary shard
+
+	shard_t *shards;
 	pthread_t thread;
 
-	struct ftdi_context ftdi;
+	// mapping of wall clock to monotonic clock, owned by beat thread
+	struct {
+		bool synced;
+		int64_t offset; // CLOCK_REALTIME minus CLOCK_MONOTONIC in ns
+		int64_t spread; // of monotonic readings bracketing the wall-clock one
+	} clock;
 
-	sched_t *list;
+	struct {
+		atomic_uint_fast64_t missed; // frame deadlines passed before wakeup
+		atomic_uint divisor; // of frame rate while degraded
+	} beat;
 
 	struct {
-		varchunk_t *rx;
-		varchunk_t *tx;
-	} rb;
+		pthread_t thread;
+		varchunk_t *rb; // framed messages per beat, ready to send
+		sem_t sem; // posted per beat and once more when composer is done
+		atomic_bool last;
+		atomic_uint pending; // composed beats not sent yet
+		atomic_uint_fast64_t skipped; // beats not sent as transmitter lagged
+	} xmit;
+
+	// frames sent ahead of beat upon immediate updates
+	struct {
+		bool enabled;
+		int64_t gap_ns; // minimal time between frames
+		int fd; // eventfd to wake beat thread
+		bool dirty; // immediate update not sent yet
+		struct timespec last; // of last composed frame
+		atomic_uint_fast64_t frames;
+	} early;
+
+	struct ftdi_context ftdi;
+#ifdef HAVE_LIBFTDI1
+	struct {
+		struct ftdi_transfer_control *tc; // of write in flight
+		int len;
+		uint8_t buf [XMIT_MAX]; // written from while in flight
+	} async;
+#endif
+	int fd; // of tty or file
+	unframer_t unframer; // of replies
+
+	// replies to STATUS and LED_OUTPUT
+	struct {
+		atomic_uint_fast64_t acks;
+		atomic_uint_fast64_t naks;
+		atomic_uint_fast64_t errors; // checksum mismatch or unexpected reply
+		atomic_uint_fast64_t missing;
+		atomic_uint_fast64_t latency; // of last reply in ns
+	} reply;
+
+	struct {
+		WINDOW *win;
+		bool colors;
+		struct timespec last; // of last redraw
+		uint8_t shown [HEIGHT_NET][WIDTH_NET]; // pixels currently on screen
+	} sim;
+
+	sched_t *list;
 
 	state_t state;
 };
 
 static atomic_bool reconnect = ATOMIC_VAR_INIT(false);
 static atomic_bool done = ATOMIC_VAR_INIT(false);
+static atomic_bool dump = ATOMIC_VAR_INIT(false);
+
+static const char *transports [] = {
+	[TRANSPORT_FTDI] = "ftdi://",
+	[TRANSPORT_TTY] = "tty://",
+	[TRANSPORT_FILE] = "file://"
+};
+
+static const uint32_t bauds [] = { // probed line rates
+	19200, 38400, 57600, 115200, 230400, 460800, 921600
+};
+
+static const uint8_t latencies [] = { // calibrated FTDI latency timers in ms
+	1, 2, 4, 8, 16
+};
+
+static const char *policies [] = {
+	[POLICY_BLOCK] = "block",
+	[POLICY_DROP] = "drop",
+	[POLICY_EVICT] = "evict"
+};
+
+static const char *overruns [] = {
+	[OVERRUN_SKIP] = "skip",
+	[OVERRUN_DROP] = "drop",
+	[OVERRUN_DEGRADE] = "degrade"
+};
 
 static void
 _sig(int num __attribute__((unused)))
@@ -86,36 +279,189 @@ _sig(int num __attribute__((unused)))
 	atomic_store(&done, true);
 }
 
+static void
+_sig_dump(int num __attribute__((unused)))
+{
+	atomic_store(&dump, true);
+}
+
+static void
+_evict_init(evict_t *evict)
+{
+	atomic_init(&evict->middle, 1);
+	evict->back = 0;
+	evict->front = 2;
+}
+
+static int
+_evict_prio(const uint8_t *buf, size_t len)
+{
+	static const char prefix [] = "/monobus/";
+	const size_t prefix_len = sizeof(prefix) - 1;
+
+	if( (len <= prefix_len) || !memchr(buf, '\0', len)
+		|| strncmp((const char *)buf, prefix, prefix_len) )
+	{
+		return -1;
+	}
+
+	char *end = NULL;
+	const unsigned long prio = strtoul((const char *)buf + prefix_len, &end, 10);
+
+	if( (end == (const char *)buf + prefix_len) || (*end != '\0') || (prio >= 32) )
+	{
+		return -1;
+	}
+
+	return prio;
+}
+
+static void
+_evict_push(shard_t *shard, const uint8_t *buf, size_t len)
+{
+	bin_update_t update;
+	const int prio = shard->bin
+		? (monobus_bin_decode(&update, buf, len) == 0 ? update.layer : -1)
+		: _evict_prio(buf, len);
+
+	if( (prio < 0) || (len > EVICT_MAX) ) // bundle or unknown message
+	{
+		atomic_fetch_add_explicit(&shard->stats.dropped, 1, memory_order_relaxed);
+		return;
+	}
+
+	evict_t *evict = &shard->evict[prio];
+
+	memcpy(evict->buf[evict->back], buf, len);
+	evict->len[evict->back] = len;
+
+	// publish back buffer, older unconsumed update gets evicted
+	const unsigned old = atomic_exchange_explicit(&evict->middle,
+		evict->back | EVICT_DIRTY, memory_order_acq_rel);
+
+	if(old & EVICT_DIRTY)
+	{
+		atomic_fetch_add_explicit(&shard->stats.evicted, 1, memory_order_relaxed);
+	}
+
+	evict->back = old & ~EVICT_DIRTY;
+
+	// route following packets via evict slots, too, until drained in order
+	atomic_fetch_add_explicit(&shard->overflow, 1, memory_order_release);
+}
+
+static const uint8_t *
+_evict_pop(evict_t *evict, size_t *len)
+{
+	if( !(atomic_load_explicit(&evict->middle, memory_order_relaxed) & EVICT_DIRTY) )
+	{
+		return NULL;
+	}
+
+	const unsigned old = atomic_exchange_explicit(&evict->middle, evict->front,
+		memory_order_acq_rel);
+
+	evict->front = old & ~EVICT_DIRTY;
+	*len = evict->len[evict->front];
+
+	return evict->buf[evict->front];
+}
+
 static void *
 _write_req(void *data, size_t minimum, size_t *maximum)
 {
-	app_t *app = data;
+	shard_t *shard = data;
+
+	// newer packets must not overtake evicted ones via the ring
+	const bool overflowed = atomic_load_explicit(&shard->overflow,
+		memory_order_acquire);
+
+	void *buf = overflowed
+		? NULL
+		: varchunk_write_request_max(shard->rb.rx, minimum, maximum);
+	if(buf)
+	{
+		return buf;
+	}
+
+	// ingress ring overflow
+	switch(shard->app->policy)
+	{
+		case POLICY_BLOCK:
+		{
+			// leave packets queued in socket until beat thread catches up
+			atomic_fetch_add_explicit(&shard->stats.blocked, 1, memory_order_relaxed);
+			shard->blocked = true;
+		}	return NULL;
+		case POLICY_DROP:
+		case POLICY_EVICT:
+		{
+			if(minimum > sizeof(shard->scratch))
+			{
+				atomic_fetch_add_explicit(&shard->stats.dropped, 1, memory_order_relaxed);
+				return NULL;
+			}
+
+			if(maximum)
+			{
+				*maximum = sizeof(shard->scratch);
+			}
+
+			shard->scratched = true;
+		}	return shard->scratch;
+	}
+
+	return NULL;
+}
 
-	return varchunk_write_request_max(app->rb.rx, minimum, maximum);
+static void
+_early_signal(app_t *app)
+{
+	if(app->early.enabled)
+	{
+		eventfd_write(app->early.fd, 1);
+	}
 }
 
 static void
 _write_adv(void *data, size_t written)
 {
-	app_t *app = data;
+	shard_t *shard = data;
+
+	if(!shard->scratched)
+	{
+		varchunk_write_advance(shard->rb.rx, written);
+		_early_signal(shard->app);
+		return;
+	}
+
+	shard->scratched = false;
 
-	varchunk_write_advance(app->rb.rx, written);
+	if(shard->app->policy == POLICY_EVICT)
+	{
+		_evict_push(shard, shard->scratch, written);
+		_early_signal(shard->app);
+	}
+	else
+	{
+		atomic_fetch_add_explicit(&shard->stats.dropped, 1, memory_order_relaxed);
+	}
 }
 
 static const void *
 _read_req(void *data, size_t *toread)
 {
-	app_t *app = data;
+	shard_t *shard = data;
 
-	return varchunk_read_request(app->rb.tx, toread);
+	return varchunk_read_request(shard->rb.tx, toread);
 }
 
 static void
 _read_adv(void *data)
 {
-	app_t *app = data;
+	shard_t *shard = data;
 
-	varchunk_read_advance(app->rb.tx);
+	varchunk_read_advance(shard->rb.tx);
 }
 
 static const LV2_OSC_Driver driver = {
@@ -129,12 +475,12 @@ static void
 _handle_osc_packet(app_t *app, uint64_t timetag, const uint8_t *buf, size_t len);
 
 static void
-_handle_osc_message(app_t *app __attribute__((unused)), LV2_OSC_Reader *reader,
-	size_t len)
+_handle_osc_message(app_t *app, LV2_OSC_Reader *reader, size_t len)
 {
 	state_t *state = &app->state;
 
 	lv2_osc_reader_match(reader, len, tree_root, state);
+	app->early.dirty = true;
 }
 
 static void
@@ -146,6 +492,57 @@ _handle_osc_bundle(app_t *app, LV2_OSC_Reader *reader, size_t len)
 	}
 }
 
+static int64_t
+_timespec_ns(const struct timespec *ts)
+{
+	return (int64_t)ts->tv_sec * NSECS + ts->tv_nsec;
+}
+
+static void
+_clock_update(app_t *app)
+{
+	int64_t offset = 0;
+	int64_t spread = INT64_MAX;
+
+	// bracket wall-clock reading by monotonic ones, keep the tightest try
+	for(unsigned i = 0; i < CLOCK_TRIES; i++)
+	{
+		struct timespec t0;
+		struct timespec wall;
+		struct timespec t1;
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		clock_gettime(CLOCK_REALTIME, &wall);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+
+		const int64_t mono0 = _timespec_ns(&t0);
+		const int64_t mono1 = _timespec_ns(&t1);
+
+		if(mono1 - mono0 < spread)
+		{
+			spread = mono1 - mono0;
+			offset = _timespec_ns(&wall) - (mono0 + spread / 2);
+		}
+	}
+
+	// slewing moves offset by less than a millisecond per beat
+	if(app->clock.synced && (llabs(offset - app->clock.offset) > CLOCK_STEP_NS) )
+	{
+		syslog(LOG_NOTICE, "[%s] wall clock stepped by %.3f ms", __func__,
+			(offset - app->clock.offset) * 1e-6);
+	}
+
+	app->clock.synced = true;
+	app->clock.offset = offset;
+	app->clock.spread = spread;
+}
+
+static int64_t
+_clock_monotonic(app_t *app, uint64_t timetag)
+{
+	return monobus_timetag_ns(timetag) - app->clock.offset;
+}
+
 static sched_t *
 _sched_append(sched_t *list, sched_t *elmnt)
 {
@@ -158,8 +555,7 @@ _sched_append(sched_t *list, sched_t *elmnt)
 	sched_t *prev = NULL;
 	for(sched_t *ptr = list; ptr; prev = ptr, ptr = ptr->next)
 	{
-		if(  (ptr->to.tv_sec > elmnt->to.tv_sec)
-			&& (ptr->to.tv_nsec > elmnt->to.tv_nsec) )
+		if(ptr->to > elmnt->to) // after elements due at the same time
 		{
 			break;
 		}
@@ -177,6 +573,27 @@ _sched_append(sched_t *list, sched_t *elmnt)
 	return list;
 }
 
+static void
+_sched_packet(app_t *app, uint64_t timetag, const uint8_t *buf, size_t len,
+	bool bin)
+{
+	sched_t *elmnt = malloc(sizeof(sched_t) + len);
+	if(elmnt)
+	{
+		elmnt->next = NULL;
+		elmnt->to = _clock_monotonic(app, timetag);
+		elmnt->bin = bin;
+		elmnt->len = len;
+		memcpy(elmnt->buf, buf, len);
+
+		app->list = _sched_append(app->list, elmnt);
+	}
+	else
+	{
+		syslog(LOG_ERR, "[%s] malloc failed", __func__);
+	}
+}
+
 static void
 _handle_osc_packet(app_t *app, uint64_t timetag, const uint8_t *buf, size_t len)
 {
@@ -195,25 +612,33 @@ _handle_osc_packet(app_t *app, uint64_t timetag, const uint8_t *buf, size_t len)
 		}
 		else
 		{
-			sched_t *elmnt = malloc(sizeof(sched_t) + len);
-			if(elmnt)
-			{
-				elmnt->next = NULL;
-				elmnt->to.tv_sec = (timetag >> 32) - JAN_1970;
-				elmnt->to.tv_nsec = (timetag && 32) * 0x1p-32 * 1e9;
-				elmnt->len = len;
-				memcpy(elmnt->buf, buf, len);
-
-				app->list = _sched_append(app->list, elmnt);
-			}
-			else
-			{
-				syslog(LOG_ERR, "[%s] malloc failed", __func__);
-			}
+			_sched_packet(app, timetag, buf, len, false);
 		}
 	}
 }
 
+static void
+_handle_bin_packet(app_t *app, bool immediate, const uint8_t *buf, size_t len)
+{
+	bin_update_t update;
+
+	if(monobus_bin_decode(&update, buf, len) != 0)
+	{
+		syslog(LOG_DEBUG, "[%s] malformed packet", __func__);
+		return;
+	}
+
+	if(!immediate && (update.flags & BIN_FLAG_TIMETAG)
+		&& (update.timetag != LV2_OSC_IMMEDIATE) )
+	{
+		_sched_packet(app, update.timetag, buf, len, true);
+		return;
+	}
+
+	monobus_bin_apply(&app->state, &update);
+	app->early.dirty = true;
+}
+
 static const payload_led_setup_t led_setup = {
 	.unknown_00 = 0x00,
 	.unknown_01 = 0xff,
@@ -252,19 +677,105 @@ static payload_led_outdat_t led_outdat = {
 };
 
 static int
-_ftdi_xmit(app_t *app, const uint8_t *buf, ssize_t sz)
+_ftdi_set_baud(app_t *app, uint32_t baud)
 {
-	if(app->simulate)
+	if(ftdi_set_baudrate(&app->ftdi, baud) != 0)
+	{
+		return -1;
+	}
+
+	return ftdi_usb_purge_buffers(&app->ftdi);
+}
+
+static int
+_ftdi_set_latency(app_t *app, uint8_t latency)
+{
+	return ftdi_set_latency_timer(&app->ftdi, latency);
+}
+
+static ssize_t
+_ftdi_recv(app_t *app, uint8_t *buf, size_t len, int timeout_ms)
+{
+	// chip only hands over received bytes after its latency timer expired
+	for(int ms = 0; ms <= timeout_ms; ms++)
+	{
+		const int nread = ftdi_read_data(&app->ftdi, buf, len);
+
+		if(nread != 0)
+		{
+			return nread;
+		}
+
+		usleep(1000);
+	}
+
+	return 0;
+}
+
+#ifdef HAVE_LIBFTDI1
+static int
+_ftdi_reap(app_t *app)
+{
+	if(!app->async.tc)
 	{
 		return 0;
 	}
 
-	if(ftdi_write_data(&app->ftdi, buf, sz) != sz)
+	const int written = ftdi_transfer_data_done(app->async.tc);
+	app->async.tc = NULL;
+
+	return (written == app->async.len) ? 0 : -1;
+}
+#endif
+
+static int
+_ftdi_drain(app_t *app)
+{
+#ifdef HAVE_LIBFTDI1
+	if(_ftdi_reap(app) != 0)
+	{
+		syslog(LOG_ERR, "[%s] '%s'", __func__, ftdi_get_error_string(&app->ftdi));
+		return 1;
+	}
+#else
+	(void)app;
+#endif
+
+	return 0;
+}
+
+static int
+_ftdi_xmit(app_t *app, const uint8_t *buf, ssize_t sz)
+{
+#ifdef HAVE_LIBFTDI1
+	// complete previous write before its buffer gets reused
+	if(_ftdi_reap(app) != 0)
+	{
+		goto failure;
+	}
+
+	if( (size_t)sz > sizeof(app->async.buf) )
 	{
+		errno = EMSGSIZE;
 		goto failure;
 	}
 
-	usleep(100000); // give slave 100ms time to reply (half-duplex)
+	// submit asynchronous write and return while it is in flight
+	memcpy(app->async.buf, buf, sz);
+	app->async.len = sz;
+	app->async.tc = ftdi_write_data_submit(&app->ftdi, app->async.buf, sz);
+	if(!app->async.tc)
+	{
+		goto failure;
+	}
+#else
+	// legacy API offers asynchronous writes only when built for libusb-0.1 on
+	// Linux, with no way to query that, blocking write it is
+	if(ftdi_write_data(&app->ftdi, buf, sz) != sz)
+	{
+		goto failure;
+	}
+#endif
 
 	return 0;
 
@@ -276,11 +787,9 @@ failure:
 static int
 _ftdi_init(app_t *app)
 {
-	if(app->simulate)
-	{
-		return 0;
-	}
-
+#ifdef HAVE_LIBFTDI1
+	app->async.tc = NULL;
+#endif
 	app->ftdi.module_detach_mode = AUTO_DETACH_SIO_MODULE;
 
 	if(ftdi_init(&app->ftdi) != 0)
@@ -314,7 +823,7 @@ _ftdi_init(app_t *app)
 		goto failure_close;
 	}
 
-	if(ftdi_set_baudrate(&app->ftdi, 19200) != 0)
+	if(ftdi_set_baudrate(&app->ftdi, app->baud) != 0)
 	{
 		goto failure_close;
 	}
@@ -339,6 +848,25 @@ _ftdi_init(app_t *app)
 		goto failure_close;
 	}
 
+	// defaults are tuned for bulk throughput, not for small frames
+	if(app->latency && (ftdi_set_latency_timer(&app->ftdi, app->latency) != 0) )
+	{
+		goto failure_close;
+	}
+
+	if(app->chunksize)
+	{
+		if(ftdi_write_data_set_chunksize(&app->ftdi, app->chunksize) != 0)
+		{
+			goto failure_close;
+		}
+
+		if(ftdi_read_data_set_chunksize(&app->ftdi, app->chunksize) != 0)
+		{
+			goto failure_close;
+		}
+	}
+
 	return 0;
 
 failure_close:
@@ -355,51 +883,659 @@ failure:
 static void
 _ftdi_deinit(app_t *app)
 {
-	if(app->simulate)
+#ifdef HAVE_LIBFTDI1
+	if(_ftdi_reap(app) != 0)
+	{
+		syslog(LOG_ERR, "[%s] '%s'", __func__, ftdi_get_error_string(&app->ftdi));
+	}
+#endif
+
+	if(ftdi_usb_close(&app->ftdi) != 0)
+	{
+		syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+	}
+
+	ftdi_deinit(&app->ftdi);
+}
+
+static int
+_tty_xmit(app_t *app, const uint8_t *buf, ssize_t sz)
+{
+	while(sz > 0)
+	{
+		const ssize_t written = write(app->fd, buf, sz);
+
+		if(written == -1)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+
+			goto failure;
+		}
+
+		buf += written;
+		sz -= written;
+	}
+
+	// wait for message to have left the wire (half-duplex)
+	if(tcdrain(app->fd) != 0)
+	{
+		goto failure;
+	}
+
+	return 0;
+
+failure:
+	syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+	return 1;
+}
+
+static int
+_tty_init(app_t *app)
+{
+	struct termios tio;
+
+	app->fd = open(app->path, O_RDWR | O_NOCTTY);
+	if(app->fd == -1)
+	{
+		goto failure;
+	}
+
+	if(tcgetattr(app->fd, &tio) != 0)
+	{
+		goto failure_close;
+	}
+
+	// raw 8N1 without flow control
+	cfmakeraw(&tio);
+	tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+	tio.c_cflag |= CLOCAL | CREAD;
+
+	if(cfsetspeed(&tio, monobus_termios_speed(app->baud)) != 0)
+	{
+		goto failure_close;
+	}
+
+	if(tcsetattr(app->fd, TCSANOW, &tio) != 0)
+	{
+		goto failure_close;
+	}
+
+	if(tcflush(app->fd, TCIOFLUSH) != 0)
+	{
+		goto failure_close;
+	}
+
+	return 0;
+
+failure_close:
+	close(app->fd);
+
+failure:
+	syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+	return -1;
+}
+
+static int
+_tty_set_baud(app_t *app, uint32_t baud)
+{
+	const speed_t speed = monobus_termios_speed(baud);
+	struct termios tio;
+
+	if( (speed == B0) || (tcgetattr(app->fd, &tio) != 0) )
+	{
+		return -1;
+	}
+
+	if(  (cfsetspeed(&tio, speed) != 0)
+		|| (tcdrain(app->fd) != 0)
+		|| (tcsetattr(app->fd, TCSANOW, &tio) != 0) )
+	{
+		return -1;
+	}
+
+	return tcflush(app->fd, TCIFLUSH);
+}
+
+static ssize_t
+_tty_recv(app_t *app, uint8_t *buf, size_t len, int timeout_ms)
+{
+	struct pollfd fds = {
+		.fd = app->fd,
+		.events = POLLIN,
+		.revents = 0
+	};
+
+	const int ret = poll(&fds, 1, timeout_ms);
+	if(ret <= 0)
+	{
+		return ret; // timeout or failure
+	}
+
+	return read(app->fd, buf, len);
+}
+
+static void
+_tty_deinit(app_t *app)
+{
+	if(close(app->fd) != 0)
+	{
+		syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+	}
+}
+
+static int
+_file_xmit(app_t *app, const uint8_t *buf, ssize_t sz)
+{
+	if(write(app->fd, buf, sz) != sz)
+	{
+		syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+		return 1;
+	}
+
+	return 0;
+}
+
+static int
+_file_init(app_t *app)
+{
+	// raw capture of all bytes that would go over the wire
+	app->fd = open(app->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(app->fd == -1)
+	{
+		syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+static const serial_driver_t serial_drivers [] = {
+	[TRANSPORT_FTDI] = {
+		.init = _ftdi_init,
+		.xmit = _ftdi_xmit,
+		.drain = _ftdi_drain,
+		.deinit = _ftdi_deinit,
+		.recv = _ftdi_recv,
+		.set_baud = _ftdi_set_baud,
+		.set_latency = _ftdi_set_latency,
+		.half_duplex = true
+	},
+	[TRANSPORT_TTY] = {
+		.init = _tty_init,
+		.xmit = _tty_xmit,
+		.drain = NULL,
+		.deinit = _tty_deinit,
+		.recv = _tty_recv,
+		.set_baud = _tty_set_baud,
+		.set_latency = NULL,
+		.half_duplex = true
+	},
+	[TRANSPORT_FILE] = {
+		.init = _file_init,
+		.xmit = _file_xmit,
+		.drain = NULL,
+		.deinit = _tty_deinit,
+		.recv = NULL,
+		.set_baud = NULL,
+		.set_latency = NULL,
+		.half_duplex = false
+	}
+};
+
+static int64_t
+_elapsed_ns(const struct timespec *from, const struct timespec *to)
+{
+	return (int64_t)(to->tv_sec - from->tv_sec) * NSECS
+		+ (to->tv_nsec - from->tv_nsec);
+}
+
+static void
+_timespec_add(struct timespec *ts, int64_t ns)
+{
+	ns += ts->tv_nsec;
+
+	ts->tv_sec += ns / NSECS;
+	ts->tv_nsec = ns % NSECS;
+
+	if(ts->tv_nsec < 0)
+	{
+		ts->tv_sec -= 1;
+		ts->tv_nsec += NSECS;
+	}
+}
+
+static bool
+_serial_reply(app_t *app, uint8_t id)
+{
+	const serial_driver_t *driver = &serial_drivers[app->transport];
+	struct timespec t0;
+	struct timespec now;
+
+	// reply window starts once the message has actually left the host
+	if(driver->drain && (driver->drain(app) != 0))
+	{
+		atomic_fetch_add_explicit(&app->reply.missing, 1, memory_order_relaxed);
+		return false;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	// wait for slave to be ready again, but not longer than it is given
+	for(now = t0; _elapsed_ns(&t0, &now) < REPLY_NS;
+		clock_gettime(CLOCK_MONOTONIC, &now))
+	{
+		uint8_t buf [64];
+		const int timeout_ms = (REPLY_NS - _elapsed_ns(&t0, &now)) / 1000000;
+
+		const ssize_t len = driver->recv(app, buf, sizeof(buf), timeout_ms);
+		if(len < 0)
+		{
+			syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+			break;
+		}
+
+		for(ssize_t i = 0; i < len; i++)
+		{
+			const uint8_t *frame;
+			size_t frame_len;
+
+			const int status = monobus_unframer_feed(&app->unframer, buf[i],
+				&frame, &frame_len);
+
+			if(status == 0)
+			{
+				continue;
+			}
+
+			if( (status == -1) || (frame_len != 2)
+				|| (frame[0] != (COMMAND_STATUS | id)) )
+			{
+				atomic_fetch_add_explicit(&app->reply.errors, 1, memory_order_relaxed);
+				continue;
+			}
+
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			atomic_store_explicit(&app->reply.latency, _elapsed_ns(&t0, &now),
+				memory_order_relaxed);
+
+			if(frame[1] == STATUS_ACK)
+			{
+				atomic_fetch_add_explicit(&app->reply.acks, 1, memory_order_relaxed);
+				return true;
+			}
+
+			atomic_fetch_add_explicit(&app->reply.naks, 1, memory_order_relaxed);
+			return false;
+		}
+	}
+
+	atomic_fetch_add_explicit(&app->reply.missing, 1, memory_order_relaxed);
+	return false;
+}
+
+static int
+_serial_xmit(app_t *app, const uint8_t *buf, ssize_t sz)
+{
+	const serial_driver_t *driver = &serial_drivers[app->transport];
+
+	if(app->simulate)
+	{
+		return 0;
+	}
+
+	if(driver->xmit(app, buf, sz) != 0)
+	{
+		return 1;
+	}
+
+	if(!driver->half_duplex)
+	{
+		return 0;
+	}
+
+	// buf[0] is framing byte
+	const uint8_t command = buf[1] & 0xf0;
+	const uint8_t id = buf[1] & 0x0f;
+
+	switch(command)
+	{
+		case COMMAND_STATUS:
+		case COMMAND_LED_OUTPUT:
+		{
+			_serial_reply(app, id); // next message as soon as slave is ready
+		} break;
+		default:
+		{
+			if(driver->drain && (driver->drain(app) != 0))
+			{
+				return 1;
+			}
+
+			usleep(REPLY_NS / 1000); // give slave 100ms time to reply (half-duplex)
+		} break;
+	}
+
+	return 0;
+}
+
+static void
+_serial_deinit(app_t *app)
+{
+	if(app->simulate)
+	{
+		return;
+	}
+
+	serial_drivers[app->transport].deinit(app);
+}
+
+static void
+_serial_reply_reset(app_t *app)
+{
+	atomic_store(&app->reply.acks, 0);
+	atomic_store(&app->reply.naks, 0);
+	atomic_store(&app->reply.errors, 0);
+	atomic_store(&app->reply.missing, 0);
+
+	monobus_unframer_reset(&app->unframer);
+}
+
+static int
+_serial_probe(app_t *app)
+{
+	const serial_driver_t *driver = &serial_drivers[app->transport];
+	uint8_t dst [8];
+	uint32_t fastest = 0;
+
+	if(!driver->set_baud || !driver->recv)
+	{
+		syslog(LOG_WARNING, "[%s] transport cannot be probed", __func__);
+		app->baud = BAUD_RATE;
+		return 0;
+	}
+
+	const ssize_t sz = monobus_message(dst, sizeof(dst), COMMAND_STATUS, SLAVE_ID,
+		NULL, 0);
+
+	// pick fastest line rate with STATUS round trips answered every time
+	for(unsigned i = 0; i < sizeof(bauds) / sizeof(*bauds); i++)
+	{
+		unsigned acks = 0;
+
+		if(driver->set_baud(app, bauds[i]) != 0)
+		{
+			continue; // unsupported by adapter
+		}
+
+		monobus_unframer_reset(&app->unframer);
+
+		for(unsigned j = 0; j < PROBE_TRIES; j++)
+		{
+			if( (driver->xmit(app, dst, sz) == 0) && _serial_reply(app, SLAVE_ID) )
+			{
+				acks++;
+			}
+		}
+
+		syslog(LOG_DEBUG, "[%s] %"PRIu32" baud: %u/%u replies", __func__, bauds[i],
+			acks, PROBE_TRIES);
+
+		if(acks == PROBE_TRIES)
+		{
+			fastest = bauds[i];
+		}
+	}
+
+	app->baud = fastest ? fastest : BAUD_RATE;
+	syslog(LOG_NOTICE, "[%s] line rate: %"PRIu32" baud", __func__, app->baud);
+
+	_serial_reply_reset(app); // probing replies are not part of the statistics
+
+	return driver->set_baud(app, app->baud);
+}
+
+static int
+_serial_calibrate(app_t *app)
+{
+	const serial_driver_t *driver = &serial_drivers[app->transport];
+	uint8_t dst [8];
+	uint64_t lowest = UINT64_MAX;
+
+	if(!driver->set_latency || !driver->recv)
+	{
+		syslog(LOG_WARNING, "[%s] transport cannot be calibrated", __func__);
+		return 0;
+	}
+
+	const ssize_t sz = monobus_message(dst, sizeof(dst), COMMAND_STATUS, SLAVE_ID,
+		NULL, 0);
+
+	// pick latency timer with lowest mean STATUS round trip answered every time
+	for(unsigned i = 0; i < sizeof(latencies) / sizeof(*latencies); i++)
+	{
+		uint64_t sum = 0;
+		unsigned acks = 0;
+
+		if(driver->set_latency(app, latencies[i]) != 0)
+		{
+			continue; // unsupported by adapter
+		}
+
+		monobus_unframer_reset(&app->unframer);
+
+		for(unsigned j = 0; j < CALIBRATE_TRIES; j++)
+		{
+			if( (driver->xmit(app, dst, sz) == 0) && _serial_reply(app, SLAVE_ID) )
+			{
+				sum += atomic_load_explicit(&app->reply.latency, memory_order_relaxed);
+				acks++;
+			}
+		}
+
+		if(acks < CALIBRATE_TRIES)
+		{
+			syslog(LOG_DEBUG, "[%s] %"PRIu8" ms: %u/%u replies", __func__,
+				latencies[i], acks, CALIBRATE_TRIES);
+			continue;
+		}
+
+		const uint64_t mean = sum / CALIBRATE_TRIES;
+
+		syslog(LOG_DEBUG, "[%s] %"PRIu8" ms: %"PRIu64" ns round trip", __func__,
+			latencies[i], mean);
+
+		if(mean < lowest)
+		{
+			lowest = mean;
+			app->latency = latencies[i];
+		}
+	}
+
+	if(lowest == UINT64_MAX)
+	{
+		syslog(LOG_WARNING, "[%s] no latency timer answered reliably", __func__);
+		app->latency = 16; // chip default
+	}
+
+	syslog(LOG_NOTICE, "[%s] latency timer: %"PRIu8" ms", __func__, app->latency);
+
+	_serial_reply_reset(app); // calibration replies are not part of the statistics
+
+	return driver->set_latency(app, app->latency);
+}
+
+static int
+_serial_init(app_t *app)
+{
+	if(app->simulate)
+	{
+		return 0;
+	}
+
+	monobus_unframer_reset(&app->unframer);
+
+	if(serial_drivers[app->transport].init(app) != 0)
+	{
+		return -1;
+	}
+
+	if(app->probe && (_serial_probe(app) != 0) )
+	{
+		_serial_deinit(app);
+		return -1;
+	}
+
+	// calibrate at final line rate, as it adds to the round trip
+	if(app->calibrate && (_serial_calibrate(app) != 0) )
+	{
+		_serial_deinit(app);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+_serial_parse(app_t *app)
+{
+	for(unsigned t = 0; t < sizeof(transports) / sizeof(*transports); t++)
+	{
+		const size_t len = strlen(transports[t]);
+
+		if(strncmp(app->serial_url, transports[t], len))
+		{
+			continue;
+		}
+
+		app->transport = t;
+		app->path = &app->serial_url[len];
+
+		switch(app->transport)
+		{
+			case TRANSPORT_FTDI:
+			{
+				// optional VID:PID, else as given by -V and -P
+				if( (app->path[0] != '\0')
+					&& (sscanf(app->path, "%"SCNx16":%"SCNx16, &app->vid, &app->pid) != 2) )
+				{
+					return -1;
+				}
+			} break;
+			case TRANSPORT_TTY:
+			case TRANSPORT_FILE:
+			{
+				if(app->path[0] == '\0')
+				{
+					return -1;
+				}
+			} break;
+		}
+
+		return 0;
+	}
+
+	return -1;
+}
+
+static varchunk_t *
+_rb_new(app_t *app, size_t *map)
+{
+	*map = 0;
+
+	if(app->huge)
 	{
-		return;
+		const size_t body_size = varchunk_body_size(app->rb_size);
+		const size_t total_size = sizeof(varchunk_t) + body_size;
+		const size_t map_size = (total_size + HUGE_SIZE - 1) & ~(HUGE_SIZE - 1);
+
+		varchunk_t *varchunk = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+		if(varchunk != MAP_FAILED)
+		{
+			mlock(varchunk, map_size); // prevent memory from being flushed to disk
+			varchunk_init(varchunk, body_size, true);
+			*map = map_size;
+
+			return varchunk;
+		}
+
+		syslog(LOG_WARNING, "[%s] huge pages unavailable: '%s'", __func__,
+			strerror(errno));
 	}
 
-	if(ftdi_usb_close(&app->ftdi) != 0)
+	return varchunk_new(app->rb_size, true);
+}
+
+static void
+_rb_free(varchunk_t *varchunk, size_t map)
+{
+	if(map)
 	{
-		syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+		munlock(varchunk, map);
+		munmap(varchunk, map);
+	}
+	else
+	{
+		varchunk_free(varchunk);
 	}
-
-	ftdi_deinit(&app->ftdi);
 }
 
 static void
-_osc_deinit(app_t *app)
+_shard_deinit(shard_t *shard)
 {
-	lv2_osc_stream_deinit(&app->stream);
+	lv2_osc_stream_deinit(&shard->stream);
 
-	if(app->rb.rx)
+	if(shard->rb.rx)
 	{
-		varchunk_free(app->rb.rx);
+		_rb_free(shard->rb.rx, shard->rb.rx_map);
+		shard->rb.rx = NULL;
 	}
 
-	if(app->rb.tx)
+	if(shard->rb.tx)
 	{
-		varchunk_free(app->rb.tx);
+		varchunk_free(shard->rb.tx);
+		shard->rb.tx = NULL;
 	}
 }
 
 static int
-_osc_init(app_t *app)
+_shard_init(app_t *app, shard_t *shard, unsigned idx)
 {
-	app->rb.rx = varchunk_new(8192, true);
-	if(!app->rb.rx)
+	shard->app = app;
+	shard->idx = idx;
+	shard->bin = (idx >= app->nshards);
+
+	shard->rb.rx = _rb_new(app, &shard->rb.rx_map);
+	if(!shard->rb.rx)
 	{
 		goto failure;
 	}
 
-	app->rb.tx = varchunk_new(8192, true);
-	if(!app->rb.tx)
+	// only polled by stream, -B and -G apply to rx ringbuffer alone
+	shard->rb.tx = varchunk_new(TX_SIZE, true);
+	if(!shard->rb.tx)
 	{
 		goto failure;
 	}
 
-	if(lv2_osc_stream_init(&app->stream, app->url, &driver, app) != 0)
+	for(unsigned prio = 0; prio < 32; prio++)
+	{
+		_evict_init(&shard->evict[prio]);
+	}
+
+	atomic_init(&shard->overflow, 0);
+
+	// OSC shards share the server port, sockets bind exclusively otherwise
+	const unsigned flags = (!shard->bin && (app->nshards > 1))
+		? LV2_OSC_STREAM_FLAG_REUSEPORT
+		: 0;
+
+	if(lv2_osc_stream_init_flags(&shard->stream,
+		shard->bin ? app->bin_url : app->url, &driver, shard, flags) != 0)
 	{
 		syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
 		goto failure;
@@ -407,6 +1543,49 @@ _osc_init(app_t *app)
 
 	return 0;
 
+failure:
+	_shard_deinit(shard);
+	return -1;
+}
+
+static void
+_osc_deinit(app_t *app)
+{
+	if(!app->shards)
+	{
+		return;
+	}
+
+	for(unsigned idx = 0; idx < app->nrings; idx++)
+	{
+		_shard_deinit(&app->shards[idx]);
+	}
+
+	free(app->shards);
+	app->shards = NULL;
+}
+
+static int
+_osc_init(app_t *app)
+{
+	app->nrings = app->nshards + (app->bin_url ? 1 : 0);
+	app->shards = calloc(app->nrings, sizeof(shard_t));
+	if(!app->shards)
+	{
+		syslog(LOG_ERR, "[%s] calloc failed", __func__);
+		return -1;
+	}
+
+	for(unsigned idx = 0; idx < app->nrings; idx++)
+	{
+		if(_shard_init(app, &app->shards[idx], idx) != 0)
+		{
+			goto failure;
+		}
+	}
+
+	return 0;
+
 failure:
 	_osc_deinit(app);
 	return -1;
@@ -428,216 +1607,579 @@ _get_bit(state_t *state, unsigned y, unsigned x)
 		}
 	}
 
-	return false;
+	return false;
+}
+
+static void
+_sim_init(app_t *app)
+{
+	setlocale(LC_ALL, "");
+	initscr();
+
+	noecho(); // don't echo eny keypresses
+	curs_set(false); // hide cursor
+
+	app->sim.colors = has_colors();
+	if(app->sim.colors)
+	{
+		start_color();
+		init_pair(1, COLOR_WHITE, COLOR_BLACK);
+		init_pair(2, COLOR_YELLOW, COLOR_BLACK);
+		init_pair(3, COLOR_BLACK, COLOR_BLACK);
+	}
+
+	// window persists, only changed pixels are redrawn each beat
+	app->sim.win = newwin(HEIGHT_NET + 2, WIDTH_NET*MUL + 2 + 1, 0, 0);
+
+	if(app->sim.colors)
+	{
+		wattron(app->sim.win, COLOR_PAIR(1));
+	}
+
+	box(app->sim.win, 0, 0);
+
+	if(app->sim.colors)
+	{
+		wattroff(app->sim.win, COLOR_PAIR(1));
+	}
+
+	memset(app->sim.shown, SIM_UNSET, sizeof(app->sim.shown));
+	app->sim.last.tv_sec = 0;
+	app->sim.last.tv_nsec = 0;
+}
+
+static void
+_sim_deinit(app_t *app)
+{
+	if(app->sim.win)
+	{
+		delwin(app->sim.win);
+		app->sim.win = NULL;
+	}
+
+	endwin();
+}
+
+static void
+_dump_bitmap(app_t *app)
+{
+	state_t *state = &app->state;
+
+	if(!app->sim.win)
+	{
+		return;
+	}
+
+	// cap redraw rate independently of frame rate
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	if(app->redraw > 0)
+	{
+		const int64_t elapsed = (int64_t)(now.tv_sec - app->sim.last.tv_sec) * NSECS
+			+ (now.tv_nsec - app->sim.last.tv_nsec);
+
+		if(elapsed < NSECS / app->redraw)
+		{
+			return; // changes are picked up by next redraw
+		}
+	}
+
+	unsigned changed = 0;
+
+	for(unsigned y = 0; y < HEIGHT_NET; y++)
+	{
+		for(unsigned x = 0; x < WIDTH_NET; x++)
+		{
+			const uint8_t bit = _get_bit(state, y, x);
+
+			if(bit == app->sim.shown[y][x])
+			{
+				continue;
+			}
+
+			app->sim.shown[y][x] = bit;
+			changed++;
+
+			if(!app->sim.colors)
+			{
+				mvwaddstr(app->sim.win, y + 1, x*MUL + 1, bit ? " ●" : "  ");
+				continue;
+			}
+
+			const attr_t attr = (bit ? COLOR_PAIR(2) : COLOR_PAIR(3)) | A_BOLD;
+
+			wattron(app->sim.win, attr);
+			mvwaddstr(app->sim.win, y + 1, x*MUL + 1, " ●");
+			wattroff(app->sim.win, attr);
+		}
+	}
+
+	if(changed == 0)
+	{
+		return;
+	}
+
+	wrefresh(app->sim.win);
+	app->sim.last = now;
+}
+
+static void
+_record_frame(app_t *app, const struct timespec *to)
+{
+	state_t *state = &app->state;
+	uint8_t bitmap [LENGTH_NET];
+
+	if(!app->rec)
+	{
+		return;
+	}
+
+	// composed frame as PBM image with beat timestamp in header comment
+	memset(bitmap, 0x0, sizeof(bitmap));
+
+	for(unsigned y = 0; y < HEIGHT_NET; y++)
+	{
+		for(unsigned x = 0; x < WIDTH_NET; x++)
+		{
+			if(_get_bit(state, y, x))
+			{
+				bitmap[y*STRIDE_NET + x/8] |= 0x80 >> (x % 8);
+			}
+		}
+	}
+
+	fprintf(app->rec, "P4\n# %"PRIi64".%09ld\n%u %u\n", (int64_t)to->tv_sec,
+		to->tv_nsec, WIDTH_NET, HEIGHT_NET);
+
+	if(fwrite(bitmap, sizeof(bitmap), 1, app->rec) != 1)
+	{
+		syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+		atomic_store(&done, true); // end xmit loop
+	}
+}
+
+static void
+_handle_shard_packet(app_t *app, shard_t *shard, const uint8_t *buf, size_t len)
+{
+	if(shard->bin)
+	{
+		_handle_bin_packet(app, false, buf, len);
+	}
+	else
+	{
+		_handle_osc_packet(app, LV2_OSC_IMMEDIATE, buf, len);
+	}
+}
+
+static void
+_shard_drain(app_t *app, shard_t *shard)
+{
+	// ring is frozen once overflowed, slots then only hold newer packets
+	uint_fast64_t overflow = atomic_load_explicit(&shard->overflow,
+		memory_order_acquire);
+
+	// read OSC messages from ringbuffer
+	varchunk_batch_t batch;
+	if(varchunk_read_request_batch(shard->rb.rx, &batch))
+	{
+		const uint8_t *buf;
+		size_t len;
+		while( (buf = varchunk_batch_next(shard->rb.rx, &batch, &len)) )
+		{
+			_handle_shard_packet(app, shard, buf, len);
+		}
+
+		varchunk_read_advance_batch(shard->rb.rx, &batch);
+	}
+
+	// read OSC messages that overflowed the ringbuffer
+	if(overflow)
+	{
+		for(unsigned prio = 0; prio < 32; prio++)
+		{
+			const uint8_t *buf;
+			size_t len;
+
+			if( (buf = _evict_pop(&shard->evict[prio], &len)) )
+			{
+				_handle_shard_packet(app, shard, buf, len);
+			}
+		}
+
+		// hand ring back to producer, unless it has evicted since
+		atomic_compare_exchange_strong_explicit(&shard->overflow, &overflow, 0,
+			memory_order_acq_rel, memory_order_relaxed);
+	}
+}
+
+static uint8_t *
+_xmit_begin(app_t *app)
+{
+	return varchunk_write_request(app->xmit.rb, XMIT_MAX);
+}
+
+static size_t
+_xmit_add(uint8_t *buf, size_t len, uint8_t command, const void *payload,
+	size_t payload_len)
+{
+	const uint8_t id = SLAVE_ID;
+	uint16_t sz;
+
+	// each framed message is prefixed by its size
+	sz = monobus_message(&buf[len + sizeof(sz)], XMIT_MAX - len - sizeof(sz),
+		command, id, payload, payload_len);
+	memcpy(&buf[len], &sz, sizeof(sz));
+
+	return len + sizeof(sz) + sz;
+}
+
+static void
+_xmit_end(app_t *app, size_t len)
+{
+	varchunk_write_advance(app->xmit.rb, len);
+	atomic_fetch_add(&app->xmit.pending, 1);
+	sem_post(&app->xmit.sem);
+}
+
+static void *
+_xmit(void *data)
+{
+	app_t *app = data;
+	bool failed = false;
+
+	while(true)
+	{
+		while(sem_wait(&app->xmit.sem) != 0)
+		{
+			// retry
+		}
+
+		size_t len;
+		const uint8_t *buf = varchunk_read_request(app->xmit.rb, &len);
+		if(!buf)
+		{
+			if(atomic_load(&app->xmit.last))
+			{
+				break; // composer is done and everything has been sent
+			}
+
+			continue;
+		}
+
+		// write MONOBUS data, one message after the other
+		for(size_t i = 0; !failed && (i < len); )
+		{
+			uint16_t sz;
+
+			memcpy(&sz, &buf[i], sizeof(sz));
+			i += sizeof(sz);
+
+			if(_serial_xmit(app, &buf[i], sz) != 0)
+			{
+				failed = true;
+				atomic_store(&done, true); // end compose loop
+			}
+
+			i += sz;
+		}
+
+		varchunk_read_advance(app->xmit.rb);
+
+		// bus is free, beat thread may send a deferred early frame now
+		if(atomic_fetch_sub(&app->xmit.pending, 1) == 1)
+		{
+			_early_signal(app);
+		}
+	}
+
+	return NULL;
+}
+
+static size_t
+_frame_compose(app_t *app, uint8_t *buf)
+{
+	state_t *state = &app->state;
+	size_t len;
+
+	// create rotated bitmap in PBM format
+	memset(led_outdat.bitmap, 0x0, LENGTH_SER);
+
+	for(unsigned y = 0; y < HEIGHT_SER; y++)
+	{
+		for(unsigned x = 0; x < WIDTH_SER; x++)
+		{
+			if(_get_bit(state, x, y))
+			{
+				const unsigned row_offset = y * STRIDE_SER;
+				const unsigned col_offset = STRIDE_SER - (x / 8) - 1;
+				uint8_t *byte = &led_outdat.bitmap[row_offset + col_offset];
+				const uint8_t mask = 1 << (x % 8);
+
+				*byte |= mask;
+			}
+		}
+	}
+
+	len = _xmit_add(buf, 0, COMMAND_LED_OUTSET, &led_outset,
+		sizeof(led_outset));
+	len = _xmit_add(buf, len, COMMAND_LED_OUTDAT, &led_outdat,
+		sizeof(led_outdat));
+	len = _xmit_add(buf, len, COMMAND_LED_OUTPUT, NULL, 0);
+
+	app->early.dirty = false;
+
+	return len;
+}
+
+static bool
+_early_wait(app_t *app, const struct timespec *to)
+{
+	struct timespec until = *to;
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	// pending update on free bus is due after minimal gap to previous frame
+	if(app->early.dirty && (atomic_load(&app->xmit.pending) == 0) )
+	{
+		struct timespec gap = app->early.last;
+		_timespec_add(&gap, app->early.gap_ns);
+
+		if(_elapsed_ns(&gap, &until) > 0)
+		{
+			until = gap;
+		}
+	}
+
+	const int64_t timeout_ns = _elapsed_ns(&now, &until);
+
+	if(timeout_ns > 0)
+	{
+		struct pollfd pfd = {
+			.fd = app->early.fd,
+			.events = POLLIN
+		};
+		const struct timespec timeout = {
+			.tv_sec = timeout_ns / NSECS,
+			.tv_nsec = timeout_ns % NSECS
+		};
+
+		if(ppoll(&pfd, 1, &timeout, NULL) > 0)
+		{
+			eventfd_t val;
+
+			eventfd_read(app->early.fd, &val);
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return _elapsed_ns(to, &now) < 0; // woken up ahead of frame deadline
 }
 
 static void
-_dump_bitmap(app_t *app)
+_early_frame(app_t *app)
 {
-	state_t *state = &app->state;
+	struct timespec now;
+	struct timespec wall;
+	uint8_t *buf;
 
-	if(!app->simulate)
+	// merge OSC messages from all ingestion shards
+	for(unsigned idx = 0; idx < app->nrings; idx++)
 	{
-		return;
+		_shard_drain(app, &app->shards[idx]);
 	}
 
-	clear();
-
-#define MUL 2
-	WINDOW *win = newwin(HEIGHT_NET + 2, WIDTH_NET*MUL + 2 + 1, 0, 0);
-
-	if(has_colors())
+	if(!app->early.dirty || (atomic_load(&app->xmit.pending) != 0) )
 	{
-		wattron(win, COLOR_PAIR(1));
+		return; // nothing to send or bus busy, transmitter wakes us when done
 	}
 
-	box(win, 0, 0);
+	clock_gettime(CLOCK_MONOTONIC, &now);
 
-	if(has_colors())
+	if(_elapsed_ns(&app->early.last, &now) < app->early.gap_ns)
 	{
-		wattroff(win, COLOR_PAIR(1));
+		return; // too close to previous frame, wait out remaining gap
 	}
 
-	for(unsigned y = 0; y < HEIGHT_NET; y++)
-	{
-		for(unsigned x = 0; x < WIDTH_NET; x++)
-		{
-			if(_get_bit(state, y, x))
-			{
-				if(has_colors())
-				{
-					wattron(win, COLOR_PAIR(2) | A_BOLD);
-				}
-
-				mvwprintw(win, y + 1, x*MUL + 1, " ●");
+	_dump_bitmap(app);
 
-				if(has_colors())
-				{
-					wattroff(win, COLOR_PAIR(2) | A_BOLD);
-				}
-			}
-			else if(has_colors())
-			{
-				wattron(win, COLOR_PAIR(3) | A_BOLD);
+	if( (buf = _xmit_begin(app)) )
+	{
+		wall = now;
+		_timespec_add(&wall, app->clock.offset);
+		_record_frame(app, &wall);
 
-				mvwprintw(win, y + 1, x*MUL + 1, " ●");
+		_xmit_end(app, _frame_compose(app, buf));
 
-				wattroff(win, COLOR_PAIR(3) | A_BOLD);
-			}
-		}
+		app->early.last = now;
+		atomic_fetch_add_explicit(&app->early.frames, 1, memory_order_relaxed);
 	}
-
-	wrefresh(win);
-	delwin(win);
 }
 
 static void *
 _beat(void *data)
 {
-	uint8_t dst [512];
-	ssize_t sz;
-
 	app_t *app = data;
-	state_t *state = &app->state;
-	const uint8_t id = 0x2;
-	const uint64_t step_ns = NSECS / app->fps;
+	const int64_t period_ns = NSECS / app->fps;
+	unsigned divisor = 1; // of frame rate while degraded
+	unsigned punctual = 0; // consecutive frames on time while degraded
+	uint8_t *buf;
+	size_t len;
 
+	// frame deadlines on monotonic clock are unaffected by wall-clock steps
 	struct timespec to;
-	clock_gettime(CLOCK_REALTIME, &to);
+	clock_gettime(CLOCK_MONOTONIC, &to);
 	to.tv_sec += 1;
 	to.tv_nsec = 0;
 
-	// write MONOBUS data
-	sz = monobus_message(dst, sizeof(dst), COMMAND_STATUS, id, NULL, 0);
-	if(_ftdi_xmit(app, dst, sz) != 0)
-	{
-		atomic_store(&done, true); // end xmit loop
-	}
+	atomic_store(&app->beat.divisor, divisor);
 
-	// write MONOBUS data
-	sz = monobus_message(dst, sizeof(dst), COMMAND_LED_SETUP, id,
-		(const uint8_t *)&led_setup, sizeof(led_setup));
-	if(_ftdi_xmit(app, dst, sz) != 0)
-	{
-		atomic_store(&done, true); // end xmit loop
-	}
+	app->clock.synced = false;
+	_clock_update(app);
+
+	// ringbuffer is empty at this point
+	buf = _xmit_begin(app);
+	len = _xmit_add(buf, 0, COMMAND_STATUS, NULL, 0);
+	len = _xmit_add(buf, len, COMMAND_LED_SETUP, &led_setup, sizeof(led_setup));
+	_xmit_end(app, len);
 
 	while(!atomic_load(&done))
 	{
-		// sleep until next beat timestamp
-		if(clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &to, NULL) == -1)
+		const int64_t step_ns = period_ns * divisor;
+		struct timespec now;
+		struct timespec wall;
+
+		// sleep until next frame deadline, or until woken for an early frame
+		if(app->early.enabled)
+		{
+			if(_early_wait(app, &to))
+			{
+				_early_frame(app);
+				continue;
+			}
+		}
+		else if(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &to, NULL) != 0)
 		{
 			continue;
 		}
 
-		// read OSC messages from ringbuffer
-		const uint8_t *buf;
-		size_t len;
-		while( (buf = varchunk_read_request(app->rb.rx, &len)) )
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		_clock_update(app);
+
+		// deadline is missed when woken up after its frame slot was over
+		const int64_t late_ns = _elapsed_ns(&to, &now);
+		const uint64_t missed = late_ns / step_ns;
+
+		if(missed)
 		{
-			_handle_osc_packet(app, LV2_OSC_IMMEDIATE, buf, len);
+			atomic_fetch_add_explicit(&app->beat.missed,
+				(app->overrun == OVERRUN_DROP) ? 1 : missed, memory_order_relaxed);
+		}
 
-			varchunk_read_advance(app->rb.rx);
+		// wall-clock time of frame deadline
+		wall = to;
+		_timespec_add(&wall, app->clock.offset);
+
+		// merge OSC messages from all ingestion shards
+		for(unsigned idx = 0; idx < app->nrings; idx++)
+		{
+			_shard_drain(app, &app->shards[idx]);
 		}
 
-		// read OSC messages from list
+		// read OSC messages from list due by frame deadline
 		for(sched_t *elmnt = app->list; elmnt; elmnt = app->list)
 		{
-			double diff = to.tv_sec - elmnt->to.tv_sec;
-			diff += (to.tv_nsec - elmnt->to.tv_nsec) * 1e-9;
-
-			if(diff < 0.0)
+			if(elmnt->to > _timespec_ns(&to))
 			{
 				break;
 			}
 
-			_handle_osc_packet(app, LV2_OSC_IMMEDIATE, elmnt->buf, elmnt->len);
+			if(elmnt->bin)
+			{
+				_handle_bin_packet(app, true, elmnt->buf, elmnt->len);
+			}
+			else
+			{
+				_handle_osc_packet(app, LV2_OSC_IMMEDIATE, elmnt->buf, elmnt->len);
+			}
 
 			app->list = elmnt->next;
 			free(elmnt);
 		}
 
-		// write MONOBUS data
-		sz = monobus_message(dst, sizeof(dst), COMMAND_LED_OUTSET, id,
-			(const uint8_t *)&led_outset, sizeof(led_outset));
-		if(_ftdi_xmit(app, dst, sz) != 0)
+		_dump_bitmap(app);
+
+		// compose next frame while transmitter is busy with the previous one
+		if(missed && (app->overrun == OVERRUN_DROP) )
 		{
-			atomic_store(&done, true); // end xmit loop
+			// late frame is not sent, its updates show up in the next one
 		}
+		else if( (buf = _xmit_begin(app)) )
+		{
+			_record_frame(app, &wall);
 
-		_dump_bitmap(app);
+			_xmit_end(app, _frame_compose(app, buf));
 
-		// create rotated bitmap in PBM format
-		memset(led_outdat.bitmap, 0x0, LENGTH_SER);
+			app->early.last = now;
+		}
+		else
+		{
+			// transmitter lags behind, a newer frame follows next beat anyway
+			atomic_fetch_add_explicit(&app->xmit.skipped, 1, memory_order_relaxed);
+		}
 
-		for(unsigned y = 0; y < HEIGHT_SER; y++)
+		// calculate next frame deadline
+		switch(app->overrun)
 		{
-			for(unsigned x = 0; x < WIDTH_SER; x++)
+			case OVERRUN_SKIP:
+			{
+				// resume at next slot ahead instead of catching up in a burst
+				_timespec_add(&to, (missed + 1) * step_ns);
+			} break;
+			case OVERRUN_DROP:
 			{
-				if(_get_bit(state, x, y))
+				// keep schedule, late slots pass through without being sent
+				_timespec_add(&to, step_ns);
+			} break;
+			case OVERRUN_DEGRADE:
+			{
+				// halve frame rate on overrun, double it after a punctual streak
+				if(missed && (divisor < DEGRADE_MAX) )
 				{
-					const unsigned row_offset = y * STRIDE_SER;
-					const unsigned col_offset = STRIDE_SER - (x / 8) - 1;
-					uint8_t *byte = &led_outdat.bitmap[row_offset + col_offset];
-					const uint8_t mask = 1 << (x % 8);
-
-					*byte |= mask;
+					divisor *= 2;
+					punctual = 0;
+				}
+				else if(!missed && (divisor > 1) && (++punctual >= DEGRADE_RECOVER) )
+				{
+					divisor /= 2;
+					punctual = 0;
 				}
-			}
-		}
-
-		// write MONOBUS data
-		sz = monobus_message(dst, sizeof(dst), COMMAND_LED_OUTDAT, id,
-			(const uint8_t *)&led_outdat, sizeof(led_outdat));
-		if(_ftdi_xmit(app, dst, sz) != 0)
-		{
-			atomic_store(&done, true); // end xmit loop
-		}
 
-		// write MONOBUS data
-		sz = monobus_message(dst, sizeof(dst), COMMAND_LED_OUTPUT, id, NULL, 0);
-		if(_ftdi_xmit(app, dst, sz) != 0)
-		{
-			atomic_store(&done, true); // end xmit loop
-		}
+				atomic_store_explicit(&app->beat.divisor, divisor, memory_order_relaxed);
 
-		// calculate next beat timestamp
-		to.tv_nsec += step_ns;
-		while(to.tv_nsec >= NSECS)
-		{
-			to.tv_sec += 1;
-			to.tv_nsec -= NSECS;
+				_timespec_add(&to, (missed + 1) * step_ns);
+			} break;
 		}
 	}
 
+	// wait for room to clear display, transmitter drains even after failure
+	while(!(buf = _xmit_begin(app)))
 	{
+		usleep(1000);
+	}
 
-		// write MONOBUS data
-		sz = monobus_message(dst, sizeof(dst), COMMAND_LED_OUTSET, id,
-			(const uint8_t *)&led_outset, sizeof(led_outset));
-		if(_ftdi_xmit(app, dst, sz) != 0)
-		{
-			atomic_store(&done, true); // end xmit loop
-		}
-
-		// clear bitmap in outdat
-		memset(led_outdat.bitmap, 0x0, LENGTH_SER);
+	// clear bitmap in outdat
+	memset(led_outdat.bitmap, 0x0, LENGTH_SER);
 
-		// write MONOBUS data
-		sz = monobus_message(dst, sizeof(dst), COMMAND_LED_OUTDAT, id,
-			(const uint8_t *)&led_outdat, sizeof(led_outdat));
-		if(_ftdi_xmit(app, dst, sz) != 0)
-		{
-			atomic_store(&done, true); // end xmit loop
-		}
+	len = _xmit_add(buf, 0, COMMAND_LED_OUTSET, &led_outset, sizeof(led_outset));
+	len = _xmit_add(buf, len, COMMAND_LED_OUTDAT, &led_outdat, sizeof(led_outdat));
+	len = _xmit_add(buf, len, COMMAND_LED_OUTPUT, NULL, 0);
+	_xmit_end(app, len);
 
-		// write MONOBUS data
-		sz = monobus_message(dst, sizeof(dst), COMMAND_LED_OUTPUT, id, NULL, 0);
-		if(_ftdi_xmit(app, dst, sz) != 0)
-		{
-			atomic_store(&done, true); // end xmit loop
-		}
-	}
+	atomic_store(&app->xmit.last, true);
+	sem_post(&app->xmit.sem);
 
 	return NULL;
 }
@@ -645,19 +2187,79 @@ _beat(void *data)
 static int
 _thread_init(app_t *app)
 {
+	app->xmit.rb = varchunk_new(XMIT_SIZE, true);
+	if(!app->xmit.rb)
+	{
+		goto failure;
+	}
+
+	if(sem_init(&app->xmit.sem, 0, 0) != 0)
+	{
+		goto failure_rb;
+	}
+
+	atomic_init(&app->xmit.last, false);
+	atomic_init(&app->xmit.pending, 0);
+
+	if(app->early.enabled)
+	{
+		app->early.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if(app->early.fd == -1)
+		{
+			goto failure_sem;
+		}
+
+		app->early.dirty = false;
+		clock_gettime(CLOCK_MONOTONIC, &app->early.last);
+	}
+
+	if(pthread_create(&app->xmit.thread, NULL, _xmit, app) != 0)
+	{
+		goto failure_fd;
+	}
+
 	if(pthread_create(&app->thread, NULL, _beat, app) != 0)
 	{
-		syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
-		return -1;
+		goto failure_xmit;
 	}
 
 	return 0;
+
+failure_xmit:
+	atomic_store(&app->xmit.last, true);
+	sem_post(&app->xmit.sem);
+	pthread_join(app->xmit.thread, NULL);
+
+failure_fd:
+	if(app->early.enabled)
+	{
+		close(app->early.fd);
+	}
+
+failure_sem:
+	sem_destroy(&app->xmit.sem);
+
+failure_rb:
+	varchunk_free(app->xmit.rb);
+
+failure:
+	syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+	return -1;
 }
 
 static void
 _thread_deinit(app_t *app)
 {
 	pthread_join(app->thread, NULL);
+	pthread_join(app->xmit.thread, NULL);
+
+	if(app->early.enabled)
+	{
+		close(app->early.fd);
+	}
+
+	sem_destroy(&app->xmit.sem);
+	varchunk_free(app->xmit.rb);
 }
 
 static void
@@ -670,6 +2272,99 @@ _sched_deinit(app_t *app)
 	}
 }
 
+static void
+_stats_dump(app_t *app)
+{
+	for(unsigned idx = 0; idx < app->nrings; idx++)
+	{
+		shard_t *shard = &app->shards[idx];
+
+		syslog(LOG_NOTICE, "[%s] shard: %u, policy: %s, blocked: %"PRIuFAST64
+			", dropped: %"PRIuFAST64", evicted: %"PRIuFAST64, __func__, idx,
+			policies[app->policy],
+			atomic_load_explicit(&shard->stats.blocked, memory_order_relaxed),
+			atomic_load_explicit(&shard->stats.dropped, memory_order_relaxed),
+			atomic_load_explicit(&shard->stats.evicted, memory_order_relaxed));
+	}
+
+	syslog(LOG_NOTICE, "[%s] skipped: %"PRIuFAST64", missed: %"PRIuFAST64
+		", overrun: %s, frame rate: 1/%u", __func__,
+		atomic_load_explicit(&app->xmit.skipped, memory_order_relaxed),
+		atomic_load_explicit(&app->beat.missed, memory_order_relaxed),
+		overruns[app->overrun],
+		atomic_load_explicit(&app->beat.divisor, memory_order_relaxed));
+
+	syslog(LOG_NOTICE, "[%s] early frames: %"PRIuFAST64, __func__,
+		atomic_load_explicit(&app->early.frames, memory_order_relaxed));
+
+	syslog(LOG_NOTICE, "[%s] acks: %"PRIuFAST64", naks: %"PRIuFAST64
+		", errors: %"PRIuFAST64", missing: %"PRIuFAST64", latency: %.1f ms",
+		__func__,
+		atomic_load_explicit(&app->reply.acks, memory_order_relaxed),
+		atomic_load_explicit(&app->reply.naks, memory_order_relaxed),
+		atomic_load_explicit(&app->reply.errors, memory_order_relaxed),
+		atomic_load_explicit(&app->reply.missing, memory_order_relaxed),
+		atomic_load_explicit(&app->reply.latency, memory_order_relaxed) * 1e-6);
+}
+
+static void
+_shard_pin(shard_t *shard)
+{
+	const long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	cpu_set_t cpuset;
+
+	if( (shard->app->nrings < 2) || (ncpus < 1) )
+	{
+		return;
+	}
+
+	CPU_ZERO(&cpuset);
+	CPU_SET(shard->idx % ncpus, &cpuset);
+
+	if(pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0)
+	{
+		syslog(LOG_WARNING, "[%s] failed to pin shard %u", __func__, shard->idx);
+	}
+}
+
+static void
+_shard_run(shard_t *shard)
+{
+	_shard_pin(shard);
+
+	while(!atomic_load(&done))
+	{
+		const LV2_OSC_Enum status = lv2_osc_stream_pollin(&shard->stream, 1000);
+
+		if(status & LV2_OSC_ERR)
+		{
+			syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+		}
+
+		if(shard->blocked)
+		{
+			// ringbuffer full, give beat thread time to drain it
+			shard->blocked = false;
+			usleep(1000);
+		}
+
+		if( (shard->idx == 0) && atomic_exchange(&dump, false) )
+		{
+			_stats_dump(shard->app);
+		}
+	}
+}
+
+static void *
+_shard_thread(void *data)
+{
+	shard_t *shard = data;
+
+	_shard_run(shard);
+
+	return NULL;
+}
+
 static int
 _loop(app_t *app)
 {
@@ -678,34 +2373,44 @@ _loop(app_t *app)
 		return -1;
 	}
 
-	if(_ftdi_init(app) == -1)
+	if(_serial_init(app) == -1)
 	{
 		_osc_deinit(app);
 		return -1;
 	}
 
+	atomic_store(&done, false);
+
 	if(_thread_init(app) == -1)
 	{
-		_ftdi_deinit(app);
+		_serial_deinit(app);
 		_osc_deinit(app);
 		return -1;
 	}
 
-	atomic_store(&done, false);
-
-	while(!atomic_load(&done))
+	// every shard gets its own thread, main thread stays unpinned so that
+	// threads spawned by it upon reconnect do not inherit a shard's core
+	unsigned nthreads = 0;
+	for( ; nthreads < app->nrings; nthreads++)
 	{
-		const LV2_OSC_Enum status = lv2_osc_stream_pollin(&app->stream, 1000);
+		shard_t *shard = &app->shards[nthreads];
 
-		if(status & LV2_OSC_ERR)
+		if(pthread_create(&shard->thread, NULL, _shard_thread, shard) != 0)
 		{
 			syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+			atomic_store(&done, true);
+			break;
 		}
 	}
 
+	for(unsigned idx = 0; idx < nthreads; idx++)
+	{
+		pthread_join(app->shards[idx].thread, NULL);
+	}
+
 	_thread_deinit(app);
 	_sched_deinit(app);
-	_ftdi_deinit(app);
+	_serial_deinit(app);
 	_osc_deinit(app);
 
 	return 0;
@@ -727,7 +2432,9 @@ _version(void)
 		"\n"
 		"You should have received a copy of the Artistic License 2.0\n"
 		"along the source as a COPYING file. If not, obtain it from\n"
-		"http://www.perlfoundation.org/artistic_license_2_0.\n\n");
+		"http://www.perlfoundation.org/artistic_license_2_0.\n"
+		"\n"
+		"Speaks bitmap protocol version %d.\n\n", MONOBUS_PROTOCOL);
 }
 
 static void
@@ -744,13 +2451,28 @@ _usage(char **argv, app_t *app)
 		"   [-d]                     enable verbose logging\n"
 		"   [-A]                     enable auto-reconnect (disabled)\n"
 		"   [-T]                     run test simulation (disabled)\n"
+		"   [-M] FPS                 maximal redraw rate of test simulation (%"PRIu32")\n"
+		"   [-W] FILE                record frames as timestamped PBM images to FILE or - (%s)\n"
+		"   [-b] BAUD                line rate, or probe for fastest one (%"PRIu32")\n"
+		"   [-I] URI                 serial transport: ftdi://[VID:PID], tty://DEVICE, file://PATH (%s)\n"
 		"   [-V] VID                 USB vendor ID (0x%04"PRIx16")\n"
 		"   [-P] PID                 USB product ID (0x%04"PRIx16")\n"
 		"   [-D] DESCRIPTION         USB product name (%s)\n"
 		"   [-S] SERIAL              USB serial ID (%s)\n"
+		"   [-l] MS                  FTDI latency timer 1-255, or calibrate for lowest one (%"PRIu8")\n"
+		"   [-c] BYTES               FTDI USB read and write chunk size (%u)\n"
 		"   [-F] FPS                 Frame rate (%"PRIu32")\n"
-		"   [-U] URI                 OSC URI (%s)\n\n"
-		, argv[0], app->vid, app->pid, app->des, app->sid, app->fps, app->url);
+		"   [-X] POLICY              frame overrun policy: skip, drop, degrade (%s)\n"
+		"   [-E] MS                  send immediate updates early, at least MS apart (disabled)\n"
+		"   [-U] URI                 OSC URI (%s)\n"
+		"   [-B] BYTES               OSC receive ringbuffer size (%zu)\n"
+		"   [-G]                     back receive ringbuffers by huge pages (disabled)\n"
+		"   [-O] POLICY              ringbuffer overflow policy: block, drop, evict (%s)\n"
+		"   [-N] THREADS             number of pinned OSC ingestion threads (%u)\n"
+		"   [-R] URI                 native binary protocol URI (%s)\n\n"
+		, argv[0], app->redraw, app->record, app->baud, app->serial_url, app->vid, app->pid, app->des, app->sid, app->latency,
+		app->chunksize, app->fps, overruns[app->overrun], app->url,
+		app->rb_size, policies[app->policy], app->nshards, app->bin_url);
 }
 
 int
@@ -760,12 +2482,19 @@ main(int argc, char **argv)
 	static app_t app;
 	int logp = LOG_INFO;
 
+	app.serial_url = transports[TRANSPORT_FTDI];
+	app.baud = BAUD_RATE;
 	app.vid = FTDI_VID;
 	app.pid = FT232_PID;
 	app.des = NULL;
 	app.sid = NULL;
 	app.fps = 2;
+	app.overrun = OVERRUN_SKIP;
+	app.redraw = 25;
 	app.url = "osc.udp://:7777";
+	app.rb_size = RB_SIZE;
+	app.policy = POLICY_BLOCK;
+	app.nshards = 1;
 
 	fprintf(stderr,
 		"%s "MONOBUS_VERSION"\n"
@@ -774,7 +2503,7 @@ main(int argc, char **argv)
 		argv[0]);
 
 	int c;
-	while( (c = getopt(argc, argv, "vhdATV:P:D:S:F:U:") ) != -1)
+	while( (c = getopt(argc, argv, "vhdATM:W:b:I:V:P:D:S:l:c:F:X:E:U:B:GO:N:R:") ) != -1)
 	{
 		switch(c)
 		{
@@ -798,6 +2527,34 @@ main(int argc, char **argv)
 			{
 				app.simulate = true;
 			}	break;
+			case 'M':
+			{
+				app.redraw = strtoul(optarg, NULL, 10);
+			} break;
+			case 'W':
+			{
+				app.record = optarg;
+			} break;
+			case 'b':
+			{
+				if(!strcmp(optarg, "probe"))
+				{
+					app.probe = true;
+				}
+				else if(monobus_termios_speed(strtoul(optarg, NULL, 10)) != B0)
+				{
+					app.baud = strtoul(optarg, NULL, 10);
+				}
+				else
+				{
+					fprintf(stderr, "Unknown baud rate `%s'.\n", optarg);
+					return -1;
+				}
+			} break;
+			case 'I':
+			{
+				app.serial_url = optarg;
+			} break;
 
 			case 'V':
 			{
@@ -815,19 +2572,122 @@ main(int argc, char **argv)
 			{
 				app.sid = optarg;
 			} break;
+			case 'l':
+			{
+				const unsigned long latency = strtoul(optarg, NULL, 10);
+
+				if(!strcmp(optarg, "calibrate"))
+				{
+					app.calibrate = true;
+				}
+				else if( (latency >= 1) && (latency <= 255) )
+				{
+					app.latency = latency;
+				}
+				else
+				{
+					fprintf(stderr, "Unknown latency timer `%s'.\n", optarg);
+					return -1;
+				}
+			} break;
+			case 'c':
+			{
+				app.chunksize = strtoul(optarg, NULL, 10);
+			} break;
 			case 'F':
 			{
 				app.fps = strtol(optarg, NULL, 10);;
 			} break;
+			case 'X':
+			{
+				if(!strcmp(optarg, overruns[OVERRUN_SKIP]))
+				{
+					app.overrun = OVERRUN_SKIP;
+				}
+				else if(!strcmp(optarg, overruns[OVERRUN_DROP]))
+				{
+					app.overrun = OVERRUN_DROP;
+				}
+				else if(!strcmp(optarg, overruns[OVERRUN_DEGRADE]))
+				{
+					app.overrun = OVERRUN_DEGRADE;
+				}
+				else
+				{
+					fprintf(stderr, "Unknown overrun policy `%s'.\n", optarg);
+					return -1;
+				}
+			} break;
+			case 'E':
+			{
+				app.early.enabled = true;
+				app.early.gap_ns = strtoul(optarg, NULL, 10) * 1000000LL;
+			} break;
 			case 'U':
 			{
 				app.url = optarg;
 			} break;
+			case 'B':
+			{
+				char *end;
+				const unsigned long rb_size = strtoul(optarg, &end, 10);
+
+				if( (*end != '\0') || (rb_size < RB_MIN) || (rb_size > RB_MAX) )
+				{
+					fprintf(stderr, "Ringbuffer size must be in %u-%u bytes.\n",
+						RB_MIN, RB_MAX);
+					return -1;
+				}
+
+				app.rb_size = rb_size;
+			} break;
+			case 'G':
+			{
+				app.huge = true;
+			} break;
+			case 'O':
+			{
+				if(!strcmp(optarg, policies[POLICY_BLOCK]))
+				{
+					app.policy = POLICY_BLOCK;
+				}
+				else if(!strcmp(optarg, policies[POLICY_DROP]))
+				{
+					app.policy = POLICY_DROP;
+				}
+				else if(!strcmp(optarg, policies[POLICY_EVICT]))
+				{
+					app.policy = POLICY_EVICT;
+				}
+				else
+				{
+					fprintf(stderr, "Unknown overflow policy `%s'.\n", optarg);
+					return -1;
+				}
+			} break;
+			case 'N':
+			{
+				app.nshards = strtoul(optarg, NULL, 10);
+
+				if( (app.nshards < 1) || (app.nshards > SHARD_MAX) )
+				{
+					fprintf(stderr, "Number of threads must be in 1-%u.\n", SHARD_MAX);
+					return -1;
+				}
+			} break;
+			case 'R':
+			{
+				app.bin_url = optarg;
+			} break;
 
 			case '?':
 			{
 				if(  (optopt == 'V') || (optopt == 'P') || (optopt == 'D')
-					|| (optopt == 'S') || (optopt == 'F') || (optopt == 'U') )
+					|| (optopt == 'S') || (optopt == 'F') || (optopt == 'U')
+					|| (optopt == 'B') || (optopt == 'O') || (optopt == 'N')
+					|| (optopt == 'R') || (optopt == 'M') || (optopt == 'W')
+					|| (optopt == 'I') || (optopt == 'b') || (optopt == 'l')
+					|| (optopt == 'c') || (optopt == 'X') || (optopt == 'E') )
 				{
 					fprintf(stderr, "Option `-%c' requires an argument.\n", optopt);
 				}
@@ -847,31 +2707,39 @@ main(int argc, char **argv)
 		}
 	}
 
+	if(_serial_parse(&app) != 0)
+	{
+		fprintf(stderr, "Unknown serial transport `%s'.\n", app.serial_url);
+		return -1;
+	}
+
 	signal(SIGINT, _sig);
 	signal(SIGTERM, _sig);
 	signal(SIGQUIT, _sig);
 	signal(SIGKILL, _sig);
+	signal(SIGUSR1, _sig_dump);
 
 	openlog(NULL, LOG_PERROR, LOG_DAEMON);
 	setlogmask(LOG_UPTO(logp));
 
-	if(app.simulate)
+	if(app.record)
 	{
-		setlocale(LC_ALL, "");
-		initscr();
+		app.rec = strcmp(app.record, "-")
+			? fopen(app.record, "w")
+			: stdout;
 
-		noecho(); // don't echo eny keypresses
-		curs_set(false); // hide cursor
-
-		if(has_colors())
+		if(!app.rec)
 		{
-			start_color();
-			init_pair(1, COLOR_WHITE, COLOR_BLACK);
-			init_pair(2, COLOR_YELLOW, COLOR_BLACK);
-			init_pair(3, COLOR_BLACK, COLOR_BLACK);
+			syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+			return -1;
 		}
 	}
 
+	if(app.simulate && !app.record) // headless simulation when recording
+	{
+		_sim_init(&app);
+	}
+
 	int ret = _loop(&app);
 
 	while(atomic_load(&reconnect))
@@ -882,9 +2750,18 @@ main(int argc, char **argv)
 		ret = _loop(&app);
 	}
 
-	if(app.simulate)
+	if(app.sim.win)
+	{
+		_sim_deinit(&app);
+	}
+
+	if(app.rec && (app.rec != stdout) )
+	{
+		fclose(app.rec);
+	}
+	else if(app.rec)
 	{
-		endwin();
+		fflush(app.rec);
 	}
 
 	return ret;
@@ -0,0 +1,43 @@
+#!/bin/sh
+
+# overflow a small ringbuffer with evict policy by a burst of updates to the
+# same layer, the last update must be what ends up being displayed
+
+set -e
+set -u
+
+monobusd="$1"
+monobusc="$2"
+url="osc.tcp://localhost:17777"
+
+dir=$(mktemp -d)
+
+head -c 224 /dev/zero > "${dir}/zeros"
+tr '\000' '\377' < "${dir}/zeros" > "${dir}/ones"
+
+for i in $( seq 1 1000 ); do
+	printf 'P4\n112 16\n'
+	cat "${dir}/zeros"
+done > "${dir}/burst.pbm"
+printf 'P4\n112 16\n' >> "${dir}/burst.pbm"
+cat "${dir}/ones" >> "${dir}/burst.pbm"
+
+"${monobusd}" -I "file://${dir}/serial.bin" -F 100 -B 4096 -O evict \
+	-W "${dir}/record.pbm" -U "osc.tcp://:17777" 2> "${dir}/log" &
+pid=$!
+sleep 0.5
+
+"${monobusc}" -S -U "${url}" -I "${dir}/burst.pbm" > /dev/null 2>&1
+sleep 0.5
+
+kill -USR1 ${pid}
+sleep 0.1
+kill ${pid}
+wait ${pid} || true
+
+status=0
+grep -q 'evicted: [1-9]' "${dir}/log" || status=1 # ringbuffer did overflow
+tail -c 224 "${dir}/record.pbm" | cmp -s - "${dir}/ones" || status=1
+
+rm -rf "${dir}"
+exit ${status}
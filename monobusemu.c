@@ -0,0 +1,585 @@
+/*
+ * Copyright (c) 2019-2020 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <signal.h>
+#include <termios.h>
+#include <stdatomic.h>
+
+#include <monobus.h>
+
+#define NSECS      1000000000
+#define CHUNK_SIZE 16 // bytes read off the wire at once
+#define BITS_BYTE  10 // 8N1 incl. start and stop bit
+
+typedef struct _app_t app_t;
+
+struct _app_t {
+	uint32_t baud;
+	const char *link;
+	const char *record;
+	FILE *rec;
+
+	int master;
+	int slave;
+
+	unframer_t unframer;
+	uint8_t id; // of last valid message
+	struct timespec wire; // when the last byte has passed the emulated wire
+
+	uint8_t outdat [LENGTH_SER]; // received, not yet output
+	uint8_t bitmap [LENGTH_SER]; // currently shown
+
+	struct {
+		uint64_t messages;
+		uint64_t frames;
+		uint64_t errors;
+	} stats;
+};
+
+static atomic_bool done = ATOMIC_VAR_INIT(false);
+static atomic_bool dump = ATOMIC_VAR_INIT(false);
+
+static void
+_sig(int num __attribute__((unused)))
+{
+	atomic_store(&done, true);
+}
+
+static void
+_sig_dump(int num __attribute__((unused)))
+{
+	atomic_store(&dump, true);
+}
+
+static void
+_wire_wait(app_t *app, size_t len)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	// bytes queue up behind each other on the wire, idle time does not count
+	if( (app->wire.tv_sec < now.tv_sec)
+		|| ( (app->wire.tv_sec == now.tv_sec) && (app->wire.tv_nsec < now.tv_nsec) ) )
+	{
+		app->wire = now;
+	}
+
+	app->wire.tv_nsec += (uint64_t)len * BITS_BYTE * NSECS / app->baud;
+	while(app->wire.tv_nsec >= NSECS)
+	{
+		app->wire.tv_sec += 1;
+		app->wire.tv_nsec -= NSECS;
+	}
+
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &app->wire, NULL) == EINTR)
+	{
+		// retry
+	}
+}
+
+static void
+_reply(app_t *app, uint8_t id, uint8_t status)
+{
+	uint8_t dst [8];
+
+	const ssize_t sz = monobus_message(dst, sizeof(dst), COMMAND_STATUS, id,
+		&status, sizeof(status));
+
+	_wire_wait(app, sz);
+
+	// like a device talking to nobody, replies nobody reads are lost
+	if( (write(app->master, dst, sz) != sz) && (errno != EAGAIN) )
+	{
+		syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+	}
+}
+
+static void
+_record_frame(app_t *app)
+{
+	uint8_t bitmap [LENGTH_NET];
+	struct timespec now;
+
+	if(!app->rec)
+	{
+		return;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	// rotate back to network orientation like recorded by monobusd
+	memset(bitmap, 0x0, sizeof(bitmap));
+
+	for(unsigned y = 0; y < HEIGHT_NET; y++)
+	{
+		for(unsigned x = 0; x < WIDTH_NET; x++)
+		{
+			const unsigned row_offset = x * STRIDE_SER;
+			const unsigned col_offset = STRIDE_SER - (y / 8) - 1;
+			const uint8_t mask = 1 << (y % 8);
+
+			if(app->bitmap[row_offset + col_offset] & mask)
+			{
+				bitmap[y*STRIDE_NET + x/8] |= 0x80 >> (x % 8);
+			}
+		}
+	}
+
+	fprintf(app->rec, "P4\n# %"PRIi64".%09ld\n%u %u\n", (int64_t)now.tv_sec,
+		now.tv_nsec, WIDTH_NET, HEIGHT_NET);
+
+	if(fwrite(bitmap, sizeof(bitmap), 1, app->rec) != 1)
+	{
+		syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+		atomic_store(&done, true);
+	}
+}
+
+static void
+_handle_message(app_t *app, const uint8_t *buf, size_t len)
+{
+	const uint8_t command = buf[0] & 0xf0;
+	const uint8_t id = buf[0] & 0x0f;
+	const uint8_t *payload = &buf[1];
+	const size_t payload_len = len - 1;
+
+	app->id = id;
+	app->stats.messages++;
+
+	switch(command)
+	{
+		case COMMAND_STATUS:
+		{
+			_reply(app, id, STATUS_ACK);
+		} break;
+		case COMMAND_LED_SETUP:
+		{
+			if(payload_len != sizeof(payload_led_setup_t))
+			{
+				goto failure;
+			}
+		} break;
+		case COMMAND_LED_OUTSET:
+		{
+			if(payload_len != sizeof(payload_led_outset_t))
+			{
+				goto failure;
+			}
+		} break;
+		case COMMAND_LED_OUTDAT:
+		{
+			const payload_led_outdat_t *outdat = (const payload_led_outdat_t *)payload;
+
+			if( (payload_len != sizeof(payload_led_outdat_t))
+				|| (outdat->len > LENGTH_SER) )
+			{
+				goto failure;
+			}
+
+			memcpy(app->outdat, outdat->bitmap, outdat->len);
+		} break;
+		case COMMAND_LED_OUTPUT:
+		{
+			memcpy(app->bitmap, app->outdat, LENGTH_SER);
+			app->stats.frames++;
+
+			_record_frame(app);
+			_reply(app, id, STATUS_ACK);
+		} break;
+		default:
+		{
+			goto failure;
+		} break;
+	}
+
+	return;
+
+failure:
+	syslog(LOG_WARNING, "[%s] malformed message 0x%02"PRIx8" (%zu bytes)",
+		__func__, buf[0], len);
+	app->stats.errors++;
+}
+
+static void
+_handle_wire(app_t *app, const uint8_t *buf, size_t len)
+{
+	for(size_t i = 0; i < len; i++)
+	{
+		const uint8_t *frame;
+		size_t frame_len;
+
+		switch(monobus_unframer_feed(&app->unframer, buf[i], &frame, &frame_len))
+		{
+			case 1:
+			{
+				_handle_message(app, frame, frame_len);
+			} break;
+			case -1:
+			{
+				syslog(LOG_WARNING, "[%s] checksum mismatch", __func__);
+				app->stats.errors++;
+
+				_reply(app, app->id, STATUS_NAK);
+			} break;
+			default:
+			{
+				// more bytes needed
+			} break;
+		}
+	}
+}
+
+static bool
+_line_match(app_t *app)
+{
+	const speed_t speed = monobus_termios_speed(app->baud);
+	struct termios tio;
+
+	// line rate of peer as set on pseudo-terminal
+	if( (speed == B0) || (tcgetattr(app->slave, &tio) != 0) )
+	{
+		return true;
+	}
+
+	return cfgetospeed(&tio) == speed;
+}
+
+static void
+_stats_dump(app_t *app)
+{
+	syslog(LOG_NOTICE, "[%s] messages: %"PRIu64", frames: %"PRIu64
+		", errors: %"PRIu64, __func__, app->stats.messages, app->stats.frames,
+		app->stats.errors);
+}
+
+static int
+_pty_init(app_t *app)
+{
+	app->master = posix_openpt(O_RDWR | O_NOCTTY);
+	if(app->master == -1)
+	{
+		goto failure;
+	}
+
+	if( (grantpt(app->master) != 0) || (unlockpt(app->master) != 0) )
+	{
+		goto failure_master;
+	}
+
+	const char *name = ptsname(app->master);
+	if(!name)
+	{
+		goto failure_master;
+	}
+
+	// keep slave open, else reads fail with EIO whenever peer closes it
+	app->slave = open(name, O_RDWR | O_NOCTTY);
+	if(app->slave == -1)
+	{
+		goto failure_master;
+	}
+
+	struct termios tio;
+	if(tcgetattr(app->slave, &tio) != 0)
+	{
+		goto failure_slave;
+	}
+
+	cfmakeraw(&tio);
+
+	if(monobus_termios_speed(app->baud) != B0)
+	{
+		cfsetspeed(&tio, monobus_termios_speed(app->baud));
+	}
+
+	if(tcsetattr(app->slave, TCSANOW, &tio) != 0)
+	{
+		goto failure_slave;
+	}
+
+	if(fcntl(app->master, F_SETFL, O_NONBLOCK) != 0)
+	{
+		goto failure_slave;
+	}
+
+	if(app->link)
+	{
+		unlink(app->link);
+
+		if(symlink(name, app->link) != 0)
+		{
+			goto failure_slave;
+		}
+	}
+
+	syslog(LOG_NOTICE, "[%s] emulating device at %s with %"PRIu32" baud",
+		__func__, app->link ? app->link : name, app->baud);
+
+	return 0;
+
+failure_slave:
+	close(app->slave);
+
+failure_master:
+	close(app->master);
+
+failure:
+	syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+	return -1;
+}
+
+static void
+_pty_deinit(app_t *app)
+{
+	if(app->link)
+	{
+		unlink(app->link);
+	}
+
+	close(app->slave);
+	close(app->master);
+}
+
+static int
+_loop(app_t *app)
+{
+	monobus_unframer_reset(&app->unframer);
+
+	while(!atomic_load(&done))
+	{
+		struct pollfd fds = {
+			.fd = app->master,
+			.events = POLLIN,
+			.revents = 0
+		};
+
+		if(atomic_exchange(&dump, false))
+		{
+			_stats_dump(app);
+		}
+
+		if(poll(&fds, 1, 1000) == -1)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+
+			syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+			return -1;
+		}
+
+		if(!(fds.revents & POLLIN))
+		{
+			continue;
+		}
+
+		// pace reception to emulated line rate
+		uint8_t buf [CHUNK_SIZE];
+		const ssize_t len = read(app->master, buf, sizeof(buf));
+
+		if(len == -1)
+		{
+			if( (errno == EAGAIN) || (errno == EINTR) )
+			{
+				continue;
+			}
+
+			syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+			return -1;
+		}
+
+		_wire_wait(app, len);
+
+		if(!_line_match(app))
+		{
+			// bytes sent at another line rate end up as noise
+			monobus_unframer_reset(&app->unframer);
+			app->stats.errors++;
+			continue;
+		}
+
+		_handle_wire(app, buf, len);
+	}
+
+	_stats_dump(app);
+
+	return 0;
+}
+
+static void
+_version(void)
+{
+	fprintf(stderr,
+		"--------------------------------------------------------------------\n"
+		"This is free software: you can redistribute it and/or modify\n"
+		"it under the terms of the Artistic License 2.0 as published by\n"
+		"The Perl Foundation.\n"
+		"\n"
+		"This source is distributed in the hope that it will be useful,\n"
+		"but WITHOUT ANY WARRANTY; without even the implied warranty of\n"
+		"MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the\n"
+		"Artistic License 2.0 for more details.\n"
+		"\n"
+		"You should have received a copy of the Artistic License 2.0\n"
+		"along the source as a COPYING file. If not, obtain it from\n"
+		"http://www.perlfoundation.org/artistic_license_2_0.\n\n");
+}
+
+static void
+_usage(char **argv, app_t *app)
+{
+	fprintf(stderr,
+		"--------------------------------------------------------------------\n"
+		"USAGE\n"
+		"   %s [OPTIONS]\n"
+		"\n"
+		"OPTIONS\n"
+		"   [-v]                     print version information\n"
+		"   [-h]                     print usage information\n"
+		"   [-d]                     enable verbose logging\n"
+		"   [-b] BAUD                emulated line rate (%"PRIu32")\n"
+		"   [-L] LINK                create symlink LINK to pseudo-terminal (%s)\n"
+		"   [-W] FILE                record frames as timestamped PBM images to FILE or - (%s)\n\n"
+		, argv[0], app->baud, app->link, app->record);
+}
+
+int
+main(int argc, char **argv)
+{
+	(void)lv2_osc_hooks; //FIXME
+	static app_t app;
+	int logp = LOG_INFO;
+
+	app.baud = 19200;
+
+	fprintf(stderr,
+		"%s "MONOBUS_VERSION"\n"
+		"Copyright (c) 2019-2020 Hanspeter Portner (dev@open-music-kontrollers.ch)\n"
+		"Released under Artistic License 2.0 by Open Music Kontrollers\n",
+		argv[0]);
+
+	int c;
+	while( (c = getopt(argc, argv, "vhdb:L:W:") ) != -1)
+	{
+		switch(c)
+		{
+			case 'v':
+			{
+				_version();
+			}	return 0;
+			case 'h':
+			{
+				_usage(argv, &app);
+			}	return 0;
+			case 'd':
+			{
+				logp = LOG_DEBUG;
+			}	break;
+
+			case 'b':
+			{
+				app.baud = strtoul(optarg, NULL, 10);
+
+				if(app.baud == 0)
+				{
+					fprintf(stderr, "Baud rate must be positive.\n");
+					return -1;
+				}
+			} break;
+			case 'L':
+			{
+				app.link = optarg;
+			} break;
+			case 'W':
+			{
+				app.record = optarg;
+			} break;
+
+			case '?':
+			{
+				if( (optopt == 'b') || (optopt == 'L') || (optopt == 'W') )
+				{
+					fprintf(stderr, "Option `-%c' requires an argument.\n", optopt);
+				}
+				else if(isprint(optopt))
+				{
+					fprintf(stderr, "Unknown option `-%c'.\n", optopt);
+				}
+				else
+				{
+					fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
+				}
+			}	return -1;
+			default:
+			{
+				// nothing
+			}	return -1;
+		}
+	}
+
+	signal(SIGINT, _sig);
+	signal(SIGTERM, _sig);
+	signal(SIGQUIT, _sig);
+	signal(SIGUSR1, _sig_dump);
+
+	openlog(NULL, LOG_PERROR, LOG_DAEMON);
+	setlogmask(LOG_UPTO(logp));
+
+	if(app.record)
+	{
+		app.rec = strcmp(app.record, "-")
+			? fopen(app.record, "w")
+			: stdout;
+
+		if(!app.rec)
+		{
+			syslog(LOG_ERR, "[%s] '%s'", __func__, strerror(errno));
+			return -1;
+		}
+	}
+
+	int ret = -1;
+
+	if(_pty_init(&app) == 0)
+	{
+		ret = _loop(&app);
+
+		_pty_deinit(&app);
+	}
+
+	if(app.rec && (app.rec != stdout) )
+	{
+		fclose(app.rec);
+	}
+	else if(app.rec)
+	{
+		fflush(app.rec);
+	}
+
+	return ret;
+}
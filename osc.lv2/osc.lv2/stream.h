@@ -71,6 +71,10 @@ typedef struct _LV2_OSC_Address LV2_OSC_Address;
 typedef struct _LV2_OSC_Driver LV2_OSC_Driver;
 typedef struct _LV2_OSC_Stream LV2_OSC_Stream;
 
+typedef enum _LV2_OSC_Stream_Flag {
+	LV2_OSC_STREAM_FLAG_REUSEPORT = (1 << 0) // share server port among sockets
+} LV2_OSC_Stream_Flag;
+
 struct _LV2_OSC_Address {
 	socklen_t len;
 	union {
@@ -94,6 +98,7 @@ struct _LV2_OSC_Stream {
 	bool slip;
 	bool serial;
 	bool connected;
+	unsigned flags;
 	int sock;
 	int fd;
 	LV2_OSC_Address self;
@@ -377,6 +382,18 @@ _lv2_osc_stream_reinit(LV2_OSC_Stream *stream)
 			goto fail;
 		}
 
+		if(stream->server && (stream->flags & LV2_OSC_STREAM_FLAG_REUSEPORT) )
+		{
+			const int reuseport = 1;
+
+			if(setsockopt(stream->sock, SOL_SOCKET,
+				SO_REUSEPORT, &reuseport, sizeof(reuseport)) == -1)
+			{
+				ev = LV2_OSC_STREAM_ERRNO(ev, errno);
+				goto fail;
+			}
+		}
+
 		if(stream->socket_family == AF_INET) // IPv4
 		{
 			if(stream->server)
@@ -661,21 +678,29 @@ fail:
 	return ev;
 }
 
-static int
-lv2_osc_stream_init(LV2_OSC_Stream *stream, const char *url,
-	const LV2_OSC_Driver *driv, void *data)
+static inline int
+lv2_osc_stream_init_flags(LV2_OSC_Stream *stream, const char *url,
+	const LV2_OSC_Driver *driv, void *data, unsigned flags)
 {
 	memset(stream, 0x0, sizeof(LV2_OSC_Stream));
 
 	strncpy(stream->url, url, sizeof(stream->url) - 1);
 	stream->driv = driv;
 	stream->data = data;
+	stream->flags = flags;
 	stream->sock = -1;
 	stream->fd = -1;
 
 	return _lv2_osc_stream_reinit(stream);
 }
 
+static inline int
+lv2_osc_stream_init(LV2_OSC_Stream *stream, const char *url,
+	const LV2_OSC_Driver *driv, void *data)
+{
+	return lv2_osc_stream_init_flags(stream, url, driv, data, 0);
+}
+
 #define SLIP_END					0300	// 0xC0, 192, indicates end of packet
 #define SLIP_ESC					0333	// 0xDB, 219, indicates byte stuffing
 #define SLIP_END_REPLACE	0334	// 0xDC, 220, ESC ESC_END means END data byte
@@ -120,6 +120,47 @@ consumer_main(void *arg)
 	return NULL;
 }
 
+static void *
+consumer_batch_main(void *arg)
+{
+	varchunk_t *varchunk = arg;
+	const uint8_t *ptr;
+	const uint8_t *end;
+	size_t toread;
+	uint64_t cnt = 0;
+	varchunk_batch_t batch;
+
+	while(cnt < iterations)
+	{
+#if !defined(_WIN32)
+		if(rand() < THRESHOLD)
+		{
+			nanosleep(&req, NULL);
+		}
+#endif
+
+		if(varchunk_read_request_batch(varchunk, &batch))
+		{
+			while( (ptr = varchunk_batch_next(varchunk, &batch, &toread)) )
+			{
+				end = ptr + toread;
+				for(const uint8_t *src=ptr; src<end; src+=sizeof(uint64_t))
+				{
+					assert(*(const uint64_t *)src == cnt);
+				}
+				cnt++;
+			}
+			varchunk_read_advance_batch(varchunk, &batch);
+		}
+		else
+		{
+			// buffer empty
+		}
+	}
+
+	return NULL;
+}
+
 static void
 test_threaded()
 {
@@ -137,6 +178,23 @@ test_threaded()
 	varchunk_free(varchunk);
 }
 
+static void
+test_threaded_batch()
+{
+	pthread_t producer;
+	pthread_t consumer;
+	varchunk_t *varchunk = varchunk_new(8192, true);
+	assert(varchunk);
+
+	pthread_create(&consumer, NULL, consumer_batch_main, varchunk);
+	pthread_create(&producer, NULL, producer_main, varchunk);
+
+	pthread_join(producer, NULL);
+	pthread_join(consumer, NULL);
+
+	varchunk_free(varchunk);
+}
+
 #if defined(VARCHUNK_USE_SHARED_MEM)
 typedef struct _varchunk_shm_t varchunk_shm_t;
 
@@ -245,6 +303,7 @@ main(int argc, char **argv)
 	assert(varchunk_is_lock_free());
 
 	test_threaded();
+	test_threaded_batch();
 
 #if defined(VARCHUNK_USE_SHARED_MEM)
 	test_shared();
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2015-2017 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <assert.h>
+#include <time.h>
+
+#include <varchunk.h>
+
+#if !defined(_WIN32)
+static const struct timespec req = {
+	.tv_sec = 0,
+	.tv_nsec = 1
+};
+#endif
+
+#define PRODUCERS 4
+#define THRESHOLD (RAND_MAX / 256)
+#define PAD(SIZE) ( ( (size_t)(SIZE) + 7U ) & ( ~7U ) )
+#define TAG(ID, CNT) ( ((uint64_t)(ID) << 56) | (CNT) )
+
+typedef struct _producer_t producer_t;
+
+struct _producer_t {
+	varchunk_mp_t *varchunk_mp;
+	pthread_t thread;
+	uint64_t id;
+	unsigned seed;
+};
+
+static uint64_t iterations = 10000000;
+
+static void *
+producer_main(void *arg)
+{
+	producer_t *producer = arg;
+	uint8_t *ptr;
+	const uint8_t *end;
+	size_t written;
+	uint64_t cnt = 0;
+
+	while(cnt < iterations)
+	{
+		written = PAD(sizeof(uint64_t) + rand_r(&producer->seed) * 512.f / RAND_MAX);
+
+		if( (ptr = varchunk_mp_write_request(producer->varchunk_mp, written)) )
+		{
+			end = ptr + written;
+			for(uint8_t *src=ptr; src<end; src+=sizeof(uint64_t))
+			{
+				*(uint64_t *)src = TAG(producer->id, cnt);
+			}
+
+#if !defined(_WIN32)
+			// delay commit to provoke out-of-order commits
+			if(rand_r(&producer->seed) < THRESHOLD)
+			{
+				nanosleep(&req, NULL);
+			}
+#endif
+
+			varchunk_mp_write_advance(producer->varchunk_mp, ptr, written);
+			cnt++;
+		}
+		else
+		{
+			// buffer full
+		}
+	}
+
+	return NULL;
+}
+
+static void
+consumer_main(varchunk_mp_t *varchunk_mp)
+{
+	const uint8_t *ptr;
+	const uint8_t *end;
+	size_t toread;
+	uint64_t cnt [PRODUCERS] = { 0 };
+	uint64_t total = 0;
+	unsigned seed = 0;
+
+	while(total < iterations * PRODUCERS)
+	{
+#if !defined(_WIN32)
+		if(rand_r(&seed) < THRESHOLD)
+		{
+			nanosleep(&req, NULL);
+		}
+#endif
+
+		if( (ptr = varchunk_mp_read_request(varchunk_mp, &toread)) )
+		{
+			assert(toread >= sizeof(uint64_t));
+
+			const uint64_t id = *(const uint64_t *)ptr >> 56;
+			assert(id < PRODUCERS);
+
+			// chunks of one producer must arrive in order and untorn
+			end = ptr + toread;
+			for(const uint8_t *src=ptr; src<end; src+=sizeof(uint64_t))
+			{
+				assert(*(const uint64_t *)src == TAG(id, cnt[id]));
+			}
+
+			varchunk_mp_read_advance(varchunk_mp);
+			cnt[id]++;
+			total++;
+		}
+		else
+		{
+			// buffer empty or oldest chunk not yet committed
+		}
+	}
+
+	for(unsigned i = 0; i < PRODUCERS; i++)
+	{
+		assert(cnt[i] == iterations);
+	}
+
+	assert(varchunk_mp_read_request(varchunk_mp, &toread) == NULL);
+}
+
+static void
+test_threaded()
+{
+	producer_t producers [PRODUCERS];
+	varchunk_mp_t *varchunk_mp = varchunk_mp_new(8192);
+	assert(varchunk_mp);
+
+	for(unsigned i = 0; i < PRODUCERS; i++)
+	{
+		producer_t *producer = &producers[i];
+
+		producer->varchunk_mp = varchunk_mp;
+		producer->id = i;
+		producer->seed = rand();
+
+		pthread_create(&producer->thread, NULL, producer_main, producer);
+	}
+
+	consumer_main(varchunk_mp);
+
+	for(unsigned i = 0; i < PRODUCERS; i++)
+	{
+		pthread_join(producers[i].thread, NULL);
+	}
+
+	varchunk_mp_free(varchunk_mp);
+}
+
+int
+main(int argc, char **argv)
+{
+	const int seed = time(NULL);
+	srand(seed);
+
+	if(argc >= 2)
+	{
+		iterations = atoi(argv[1]);
+	}
+
+	test_threaded();
+
+	return 0;
+}
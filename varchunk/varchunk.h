@@ -37,6 +37,8 @@ extern "C" {
  *****************************************************************************/
 
 typedef struct _varchunk_t varchunk_t;
+typedef struct _varchunk_batch_t varchunk_batch_t;
+typedef struct _varchunk_mp_t varchunk_mp_t;
 
 static inline bool
 varchunk_is_lock_free(void);
@@ -68,10 +70,44 @@ varchunk_read_request(varchunk_t *varchunk, size_t *toread);
 static inline void
 varchunk_read_advance(varchunk_t *varchunk);
 
+static inline bool
+varchunk_read_request_batch(varchunk_t *varchunk, varchunk_batch_t *batch);
+
+static inline const void *
+varchunk_batch_next(varchunk_t *varchunk, varchunk_batch_t *batch,
+	size_t *toread);
+
+static inline void
+varchunk_read_advance_batch(varchunk_t *varchunk, varchunk_batch_t *batch);
+
+// multi-producer, single-consumer variant
+
+static inline varchunk_mp_t *
+varchunk_mp_new(size_t minimum);
+
+static inline void
+varchunk_mp_free(varchunk_mp_t *varchunk_mp);
+
+static inline void *
+varchunk_mp_write_request(varchunk_mp_t *varchunk_mp, size_t minimum);
+
+static inline void
+varchunk_mp_write_advance(varchunk_mp_t *varchunk_mp, void *buf, size_t written);
+
+static inline const void *
+varchunk_mp_read_request(varchunk_mp_t *varchunk_mp, size_t *toread);
+
+static inline void
+varchunk_mp_read_advance(varchunk_mp_t *varchunk_mp);
+
 /*****************************************************************************
  * API END
  *****************************************************************************/
 
+#if !defined(VARCHUNK_CACHE_LINE)
+#	define VARCHUNK_CACHE_LINE 64
+#endif
+
 #define VARCHUNK_PAD(SIZE) ( ( (size_t)(SIZE) + 7U ) & ( ~7U ) )
 
 typedef struct _varchunk_elmnt_t varchunk_elmnt_t;
@@ -82,19 +118,29 @@ struct _varchunk_elmnt_t {
 };
 
 struct _varchunk_t {
-  size_t size;
-  size_t mask;
-	size_t rsvd;
-	size_t gapd;
+	size_t size;
+	size_t mask;
 
 	memory_order acquire;
 	memory_order release;
 
-  atomic_size_t head;
-  atomic_size_t tail;
+	// producer-owned cache line
+	atomic_size_t head __attribute__((aligned(VARCHUNK_CACHE_LINE)));
+	size_t tail_cache; // producer's last seen tail
+	size_t rsvd;
+	size_t gapd;
+
+	// consumer-owned cache line
+	atomic_size_t tail __attribute__((aligned(VARCHUNK_CACHE_LINE)));
+	size_t head_cache; // consumer's last seen head
+
+	uint8_t buf [] __attribute__((aligned(VARCHUNK_CACHE_LINE)));
+};
 
-  uint8_t buf [] __attribute__((aligned(sizeof(varchunk_elmnt_t))));
-}; 
+struct _varchunk_batch_t {
+	size_t tail; // local read position
+	size_t head; // snapshot of write head
+};
 
 static inline bool
 varchunk_is_lock_free(void)
@@ -126,6 +172,8 @@ varchunk_init(varchunk_t *varchunk, size_t body_size, bool release_and_acquire)
 
 	atomic_init(&varchunk->head, 0);
 	atomic_init(&varchunk->tail, 0);
+	varchunk->tail_cache = 0;
+	varchunk->head_cache = 0;
 
 	varchunk->size = body_size;
 	varchunk->mask = varchunk->size - 1;
@@ -140,9 +188,9 @@ varchunk_new(size_t minimum, bool release_and_acquire)
 	const size_t total_size = sizeof(varchunk_t) + body_size;
 
 #if defined(_WIN32)
-	varchunk = _aligned_malloc(total_size, sizeof(varchunk_elmnt_t));
+	varchunk = _aligned_malloc(total_size, VARCHUNK_CACHE_LINE);
 #else
-	posix_memalign((void **)&varchunk, sizeof(varchunk_elmnt_t), total_size);
+	posix_memalign((void **)&varchunk, VARCHUNK_CACHE_LINE, total_size);
 	mlock(varchunk, total_size); // prevent memory from being flushed to disk
 #endif
 
@@ -173,15 +221,11 @@ _varchunk_write_advance_raw(varchunk_t *varchunk, size_t head, size_t written)
 }
 
 static inline void *
-varchunk_write_request_max(varchunk_t *varchunk, size_t minimum, size_t *maximum)
+_varchunk_write_request_raw(varchunk_t *varchunk, size_t head, size_t tail,
+	size_t padded, size_t *maximum)
 {
-	assert(varchunk);
-
 	size_t space; // size of writable buffer
 	size_t end; // virtual end of writable buffer
-	const size_t head = atomic_load_explicit(&varchunk->head, memory_order_relaxed); // read head
-	const size_t tail = atomic_load_explicit(&varchunk->tail, varchunk->acquire); // read tail (consumer modifies it any time)
-	const size_t padded = 2*sizeof(varchunk_elmnt_t) + VARCHUNK_PAD(minimum);
 
 	// calculate writable space
 	if(head > tail)
@@ -253,6 +297,31 @@ varchunk_write_request_max(varchunk_t *varchunk, size_t minimum, size_t *maximum
 	}
 }
 
+static inline void *
+varchunk_write_request_max(varchunk_t *varchunk, size_t minimum, size_t *maximum)
+{
+	assert(varchunk);
+
+	const size_t head = atomic_load_explicit(&varchunk->head, memory_order_relaxed); // read head
+	const size_t padded = 2*sizeof(varchunk_elmnt_t) + VARCHUNK_PAD(minimum);
+
+	// try with cached tail first, unless caller wants the whole writable region
+	if(!maximum)
+	{
+		void *buf = _varchunk_write_request_raw(varchunk, head,
+			varchunk->tail_cache, padded, NULL);
+
+		if(buf)
+			return buf;
+	}
+
+	// refresh cached tail (consumer modifies it any time)
+	varchunk->tail_cache = atomic_load_explicit(&varchunk->tail, varchunk->acquire);
+
+	return _varchunk_write_request_raw(varchunk, head, varchunk->tail_cache,
+		padded, maximum);
+}
+
 static inline void *
 varchunk_write_request(varchunk_t *varchunk, size_t minimum)
 {
@@ -307,7 +376,11 @@ varchunk_read_request(varchunk_t *varchunk, size_t *toread)
 	assert(varchunk);
 	size_t space; // size of available buffer
 	const size_t tail = atomic_load_explicit(&varchunk->tail, memory_order_relaxed); // read tail
-	const size_t head = atomic_load_explicit(&varchunk->head, varchunk->acquire); // read head (producer modifies it any time)
+
+	// refresh cached head only when it signals an empty buffer
+	if(varchunk->head_cache == tail)
+		varchunk->head_cache = atomic_load_explicit(&varchunk->head, varchunk->acquire); // read head (producer modifies it any time)
+	const size_t head = varchunk->head_cache;
 
 	// calculate readable space
 	if(head > tail)
@@ -375,6 +448,291 @@ varchunk_read_advance(varchunk_t *varchunk)
 		sizeof(varchunk_elmnt_t) + VARCHUNK_PAD(elmnt->size));
 }
 
+static inline bool
+varchunk_read_request_batch(varchunk_t *varchunk, varchunk_batch_t *batch)
+{
+	assert(varchunk);
+	assert(batch);
+
+	// snapshot everything written so far with a single acquire
+	batch->tail = atomic_load_explicit(&varchunk->tail, memory_order_relaxed);
+	batch->head = atomic_load_explicit(&varchunk->head, varchunk->acquire);
+	varchunk->head_cache = batch->head;
+
+	return batch->head != batch->tail;
+}
+
+static inline const void *
+varchunk_batch_next(varchunk_t *varchunk, varchunk_batch_t *batch,
+	size_t *toread)
+{
+	assert(varchunk);
+	assert(batch);
+
+	while(batch->tail != batch->head)
+	{
+		const uint8_t *buf = varchunk->buf + batch->tail;
+		const varchunk_elmnt_t *elmnt = (const varchunk_elmnt_t *)buf;
+
+		batch->tail = (batch->tail + sizeof(varchunk_elmnt_t)
+			+ VARCHUNK_PAD(elmnt->size)) & varchunk->mask;
+
+		if(elmnt->gap) // skip gap, it always extends to end of buffer
+			continue;
+
+		*toread = elmnt->size;
+		return buf + sizeof(varchunk_elmnt_t);
+	}
+
+	*toread = 0;
+	return NULL;
+}
+
+static inline void
+varchunk_read_advance_batch(varchunk_t *varchunk, varchunk_batch_t *batch)
+{
+	assert(varchunk);
+	assert(batch);
+
+	// release all chunks iterated over with a single store
+	atomic_store_explicit(&varchunk->tail, batch->tail, varchunk->release);
+}
+
+/*****************************************************************************
+ * Multi-producer, single-consumer variant
+ *
+ * Producers reserve contiguous space by advancing a shared monotonic head
+ * with compare-and-swap (a plain fetch-add cannot back out on a full buffer
+ * or insert a gap at wrap-around) and may commit out of order. Commits are
+ * published via a bitmap with one bit per 8-byte slot, so stale bytes from a
+ * previous lap can never be mistaken for a committed chunk. The consumer
+ * reads chunks in reservation order and stops at the first uncommitted one,
+ * it never blocks or spins and thus stays realtime-safe.
+ *****************************************************************************/
+
+#define VARCHUNK_MP_GAP UINT32_MAX
+#define VARCHUNK_MP_BITS (sizeof(unsigned) * 8)
+
+typedef struct _varchunk_mp_elmnt_t varchunk_mp_elmnt_t;
+
+struct _varchunk_mp_elmnt_t {
+	uint32_t size; // written size or VARCHUNK_MP_GAP
+	uint32_t span; // reserved size including this header
+};
+
+struct _varchunk_mp_t {
+	size_t size;
+	size_t mask;
+	atomic_uint *commit; // one bit per 8-byte slot, placed after buf
+
+	// shared by all producers
+	atomic_size_t head __attribute__((aligned(VARCHUNK_CACHE_LINE)));
+
+	// consumer-owned cache line
+	atomic_size_t tail __attribute__((aligned(VARCHUNK_CACHE_LINE)));
+
+	uint8_t buf [] __attribute__((aligned(VARCHUNK_CACHE_LINE)));
+};
+
+static inline size_t
+_varchunk_mp_commit_words(size_t body_size)
+{
+	const size_t slots = body_size / sizeof(varchunk_mp_elmnt_t);
+
+	return (slots + VARCHUNK_MP_BITS - 1) / VARCHUNK_MP_BITS;
+}
+
+static inline varchunk_mp_t *
+varchunk_mp_new(size_t minimum)
+{
+	varchunk_mp_t *varchunk_mp = NULL;
+
+	const size_t body_size = varchunk_body_size(
+		minimum < VARCHUNK_CACHE_LINE ? VARCHUNK_CACHE_LINE : minimum);
+	const size_t words = _varchunk_mp_commit_words(body_size);
+	const size_t total_size = sizeof(varchunk_mp_t) + body_size
+		+ words * sizeof(atomic_uint);
+
+#if defined(_WIN32)
+	varchunk_mp = _aligned_malloc(total_size, VARCHUNK_CACHE_LINE);
+#else
+	posix_memalign((void **)&varchunk_mp, VARCHUNK_CACHE_LINE, total_size);
+	mlock(varchunk_mp, total_size); // prevent memory from being flushed to disk
+#endif
+
+	if(varchunk_mp)
+	{
+		varchunk_mp->size = body_size;
+		varchunk_mp->mask = body_size - 1;
+		varchunk_mp->commit = (atomic_uint *)(varchunk_mp->buf + body_size);
+
+		for(size_t i = 0; i < words; i++)
+			atomic_init(&varchunk_mp->commit[i], 0);
+
+		atomic_init(&varchunk_mp->head, 0);
+		atomic_init(&varchunk_mp->tail, 0);
+	}
+
+	return varchunk_mp;
+}
+
+static inline void
+varchunk_mp_free(varchunk_mp_t *varchunk_mp)
+{
+	if(varchunk_mp)
+	{
+#if !defined(_WIN32)
+		const size_t total_size = sizeof(varchunk_mp_t) + varchunk_mp->size
+			+ _varchunk_mp_commit_words(varchunk_mp->size) * sizeof(atomic_uint);
+
+		munlock(varchunk_mp, total_size);
+#endif
+		free(varchunk_mp);
+	}
+}
+
+static inline void
+_varchunk_mp_commit(varchunk_mp_t *varchunk_mp, size_t offset)
+{
+	const size_t slot = offset / sizeof(varchunk_mp_elmnt_t);
+	const unsigned bit = 1U << (slot % VARCHUNK_MP_BITS);
+
+	// publish header and data written so far
+	atomic_fetch_or_explicit(&varchunk_mp->commit[slot / VARCHUNK_MP_BITS], bit,
+		memory_order_release);
+}
+
+static inline bool
+_varchunk_mp_committed(varchunk_mp_t *varchunk_mp, size_t offset)
+{
+	const size_t slot = offset / sizeof(varchunk_mp_elmnt_t);
+	const unsigned bit = 1U << (slot % VARCHUNK_MP_BITS);
+
+	return atomic_load_explicit(&varchunk_mp->commit[slot / VARCHUNK_MP_BITS],
+		memory_order_acquire) & bit;
+}
+
+static inline void
+_varchunk_mp_uncommit(varchunk_mp_t *varchunk_mp, size_t offset)
+{
+	const size_t slot = offset / sizeof(varchunk_mp_elmnt_t);
+	const unsigned bit = 1U << (slot % VARCHUNK_MP_BITS);
+
+	// producers may concurrently set other bits of the same word
+	atomic_fetch_and_explicit(&varchunk_mp->commit[slot / VARCHUNK_MP_BITS], ~bit,
+		memory_order_relaxed);
+}
+
+static inline void *
+varchunk_mp_write_request(varchunk_mp_t *varchunk_mp, size_t minimum)
+{
+	assert(varchunk_mp);
+
+	const size_t span = sizeof(varchunk_mp_elmnt_t) + VARCHUNK_PAD(minimum);
+	size_t head = atomic_load_explicit(&varchunk_mp->head, memory_order_relaxed);
+	size_t offset;
+	size_t gap;
+
+	do
+	{
+		offset = head & varchunk_mp->mask;
+		gap = (offset + span > varchunk_mp->size)
+			? varchunk_mp->size - offset // chunk would wrap, pad end with gap
+			: 0;
+
+		// read tail (consumer modifies it any time)
+		const size_t tail = atomic_load_explicit(&varchunk_mp->tail,
+			memory_order_acquire);
+
+		if(head + gap + span - tail > varchunk_mp->size) // not enough space
+			return NULL;
+	} while(!atomic_compare_exchange_weak_explicit(&varchunk_mp->head, &head,
+		head + gap + span, memory_order_relaxed, memory_order_relaxed));
+
+	if(gap > 0)
+	{
+		// fill and commit end of buffer with gap right away
+		varchunk_mp_elmnt_t *elmnt = (varchunk_mp_elmnt_t *)(varchunk_mp->buf + offset);
+		elmnt->size = VARCHUNK_MP_GAP;
+		elmnt->span = gap;
+
+		_varchunk_mp_commit(varchunk_mp, offset);
+		offset = 0;
+	}
+
+	varchunk_mp_elmnt_t *elmnt = (varchunk_mp_elmnt_t *)(varchunk_mp->buf + offset);
+	elmnt->size = 0;
+	elmnt->span = span;
+
+	return varchunk_mp->buf + offset + sizeof(varchunk_mp_elmnt_t);
+}
+
+static inline void
+varchunk_mp_write_advance(varchunk_mp_t *varchunk_mp, void *buf, size_t written)
+{
+	assert(varchunk_mp);
+	assert(buf);
+
+	varchunk_mp_elmnt_t *elmnt = (varchunk_mp_elmnt_t *)buf - 1;
+	const size_t offset = (uint8_t *)elmnt - varchunk_mp->buf;
+
+	// fail miserably if stupid programmer tries to write more than reserved
+	assert(sizeof(varchunk_mp_elmnt_t) + written <= elmnt->span);
+
+	elmnt->size = written;
+
+	_varchunk_mp_commit(varchunk_mp, offset);
+}
+
+static inline const void *
+varchunk_mp_read_request(varchunk_mp_t *varchunk_mp, size_t *toread)
+{
+	assert(varchunk_mp);
+
+	size_t tail = atomic_load_explicit(&varchunk_mp->tail, memory_order_relaxed);
+
+	while(true)
+	{
+		const size_t offset = tail & varchunk_mp->mask;
+
+		if(!_varchunk_mp_committed(varchunk_mp, offset)) // empty or uncommitted
+		{
+			*toread = 0;
+			return NULL;
+		}
+
+		const varchunk_mp_elmnt_t *elmnt = (const varchunk_mp_elmnt_t *)(varchunk_mp->buf + offset);
+
+		if(elmnt->size != VARCHUNK_MP_GAP) // valid chunk, use it!
+		{
+			*toread = elmnt->size;
+			return varchunk_mp->buf + offset + sizeof(varchunk_mp_elmnt_t);
+		}
+
+		// skip gap
+		_varchunk_mp_uncommit(varchunk_mp, offset);
+		tail += elmnt->span;
+		atomic_store_explicit(&varchunk_mp->tail, tail, memory_order_release);
+	}
+}
+
+static inline void
+varchunk_mp_read_advance(varchunk_mp_t *varchunk_mp)
+{
+	assert(varchunk_mp);
+
+	const size_t tail = atomic_load_explicit(&varchunk_mp->tail, memory_order_relaxed);
+	const size_t offset = tail & varchunk_mp->mask;
+	const varchunk_mp_elmnt_t *elmnt = (const varchunk_mp_elmnt_t *)(varchunk_mp->buf + offset);
+
+	// only consumer is allowed to advance read tail
+	_varchunk_mp_uncommit(varchunk_mp, offset);
+	atomic_store_explicit(&varchunk_mp->tail, tail + elmnt->span,
+		memory_order_release);
+}
+
+#undef VARCHUNK_MP_BITS
+#undef VARCHUNK_MP_GAP
 #undef VARCHUNK_PAD
 
 #ifdef __cplusplus